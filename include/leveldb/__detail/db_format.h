@@ -53,6 +53,7 @@ namespace simple_leveldb {
 	};
 
 	void         append_internal_key( core::string* result, const parsed_internal_key& key );
+	bool         parse_internal_key( const slice& internal_key, parsed_internal_key* result );
 	inline slice extract_user_key( const slice& internal_key ) {
 		assert( internal_key.size() >= 8 );
 		return slice( internal_key.data(), internal_key.size() - 8 );
@@ -17,6 +17,7 @@
 #include <atomic>
 #include <cstdint>
 #include <set>
+#include <vector>
 
 namespace simple_leveldb {
 
@@ -29,16 +30,24 @@ namespace simple_leveldb {
 		friend class db;
 		class writer;
 		class compaction_state;
+		class sub_compaction_state;
 
 	private:
 		struct manual_compaction {
 			int32_t             level;
 			bool                done;
+			bool                in_progress;// A background job is compacting it
 			const internal_key* begin;
 			const internal_key* end;
 			internal_key        tmp_storage;
 		};
 
+		// A full memtable waiting to be flushed, and the log holding its writes.
+		struct immutable_mem_table {
+			mem_table* mem;
+			uint64_t   log_number;
+		};
+
 	private:
 		env*                          env_;
 		const internal_key_comparator internal_comparator_;
@@ -55,14 +64,24 @@ namespace simple_leveldb {
 		core::atomic_bool shutting_down_;
 		port::cond_var    background_work_finished_signal_;
 		mem_table*        mem_;
-		mem_table*        imm_;
 		writable_file*    log_file_;
 		uint64_t          logfile_number_;
 		log::writer*      log_;
 
+		// Full memtables, oldest first.  A flush takes all of them at once.
+		core::vector< immutable_mem_table > imm_;
+
 		core::set< uint64_t > pending_outputs_;
 
-		bool background_compaction_scheduled_;
+		// Flushes run on the env's kHigh pool and compactions on its kLow
+		// pool, so a flush can proceed while a compaction is running.
+		bool    background_flush_scheduled_;
+		int32_t background_compactions_scheduled_;
+
+		// Set when a background job found nothing it could compact alongside
+		// the running ones, so that no more are scheduled until a flush or a
+		// compaction finishes and changes the picture.
+		bool compaction_blocked_;
 
 		manual_compaction* manual_compaction_;
 
@@ -81,22 +100,33 @@ namespace simple_leveldb {
 	public:
 		status Put( const write_options&, const slice& key, const slice& value ) override;
 		status Write( const write_options&, write_batch* batch ) override;
+		bool   GetProperty( const slice& property, core::string* value ) override;
 
 	private:
 		const comparator* user_comparator() const;
 
+		mem_table*  new_mem_table() const;
 		status      NewDB();
 		status      Recover( version_edit* edit, bool* save_manifest );
 		void        RemoveObsoleteFiles();
 		status      RecoverLogFile( uint64_t log_number, bool last_log, bool* save_manifest,
 																version_edit* edit, sequence_number* max_sequence );
 		void        MaybeScheduleCompaction();
+		static void bg_flush_work( void* db );
+		void        background_flush_call();
 		static void bg_work( void* db );
 		void        background_call();
 		void        background_compaction();
+		status      make_room_for_write( bool force );
 		void        compact_mem_table();
+		status      write_level0_table( const core::vector< mem_table* >& mems, version_edit* edit );
 		void        cleanup_compaction( compaction_state* compact );
 		status      do_compaction_work( compaction_state* compact );
+		void        do_subcompaction_work( compaction_state* compact, sub_compaction_state* sub );
+		status      open_compaction_output_file( sub_compaction_state* sub );
+		status      finish_compaction_output_file( compaction_state* compact, sub_compaction_state* sub,
+																							 iterator* input );
+		status      install_compaction_results( compaction_state* compact );
 		void        record_background_error( const status& s );
 	};
 
@@ -3,7 +3,12 @@
 
 #include "leveldb/__detail/db_format.h"
 #include "leveldb/__detail/skip_list.h"
+#include "leveldb/cache.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
 #include "util/arena.h"
+#include "util/cache_reservation.h"
+#include <cassert>
 #include <cstdint>
 namespace simple_leveldb {
 
@@ -24,19 +29,48 @@ namespace simple_leveldb {
 		using table = skip_list< const char*, key_comparator >;
 
 	private:
-		key_comparator comparator_;
-		int32_t        refs_;
-		arena          arena_;
-		table          table_;
+		key_comparator    comparator_;
+		int32_t           refs_;
+		arena             arena_;
+		table             table_;
+		cache_reservation reservation_;
 
 	public:
-		explicit mem_table( const internal_key_comparator& comparator );
+		// If "block_cache" is not nullptr the arena is charged to it as it
+		// grows (see options::charge_memory_to_block_cache).
+		explicit mem_table( const internal_key_comparator& comparator, cache* block_cache = nullptr );
 		mem_table( const mem_table& )            = delete;
 		mem_table& operator=( const mem_table& ) = delete;
 		~mem_table();
 
 	public:
 		void ref() { ++refs_; }
+
+		// Drop reference count.  Delete if no more references exist.
+		void unref() {
+			--refs_;
+			assert( refs_ >= 0 );
+			if ( refs_ <= 0 ) {
+				delete this;
+			}
+		}
+
+		// Returns an estimate of the number of bytes of data in use by this
+		// data structure.  It is safe to call when mem_table is being modified.
+		size_t approximate_memory_usage() const { return arena_.memory_usage(); }
+
+		// Add an entry into memtable that maps key to value at the
+		// specified sequence number and with the specified type.
+		// Typically value will be empty if type==kTypeDeletion.
+		void add( sequence_number seq, value_type type, const slice& key, const slice& value );
+
+		// Return an iterator that yields the contents of the memtable.
+		//
+		// The caller must ensure that the underlying mem_table remains live
+		// while the returned iterator is live.  The keys returned by this
+		// iterator are internal keys encoded by append_internal_key in the
+		// db_format module.
+		iterator* new_iterator();
 	};
 
 }// namespace simple_leveldb
@@ -0,0 +1,63 @@
+#ifndef STORAGE_SIMPEL_LEVELDB_INCLUDE_DETAIL_SECONDARY_TIER_H
+#define STORAGE_SIMPEL_LEVELDB_INCLUDE_DETAIL_SECONDARY_TIER_H
+
+#include "leveldb/cache.h"
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <cstddef>
+#include <string>
+
+namespace simple_leveldb {
+
+	// Storage for the bytes of entries evicted from a tiered cache's primary
+	// tier (see new_tiered_cache()).  Best effort: a tier may drop anything
+	// at any time, so look_up() can miss after insert().
+	//
+	// Safe for concurrent use.
+	class secondary_tier {
+	public:
+		secondary_tier()                                   = default;
+		secondary_tier( const secondary_tier& )            = delete;
+		secondary_tier& operator=( const secondary_tier& ) = delete;
+		virtual ~secondary_tier();
+
+	public:
+		// Store "data" under "key".  Callers erase() keys whose data changes,
+		// so data still held for "key" is identical and may be kept instead.
+		virtual void insert( const slice& key, const slice& data ) = 0;
+
+		// On a hit store the data for "key" in "*data" and return true.
+		virtual bool look_up( const slice& key, core::string* data ) = 0;
+
+		// "key" was read back into the primary tier.  The tier may drop its
+		// copy, or keep it so that demoting the key again costs nothing.
+		virtual void promoted( const slice& key ) = 0;
+
+		virtual void erase( const slice& key ) = 0;
+
+		// Drop everything.
+		virtual void prune() = 0;
+
+		// Memory held by the tier, in bytes.
+		virtual size_t total_charge() const = 0;
+	};
+
+	// Return a cache in front of "tier": values are kept in "primary" and,
+	// when evicted from it, handed to "tier" as bytes (see cache::item_helper).
+	// Takes ownership of both.
+	cache* new_tiered_cache( cache* primary, secondary_tier* tier );
+
+	// A tier that keeps up to "capacity" bytes in memory, evicting LRU.
+	secondary_tier* new_memory_tier( size_t capacity );
+
+	// A tier of log-structured files of "file_size" bytes under "dir",
+	// holding up to "capacity" bytes in total.  Every record carries a crc32c
+	// that is verified on each read.  Files under "dir" from earlier
+	// instances are removed.
+	status new_file_tier( env* env, const core::string& dir, size_t capacity, size_t file_size,
+												secondary_tier** result );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPEL_LEVELDB_INCLUDE_DETAIL_SECONDARY_TIER_H
@@ -229,7 +229,7 @@ namespace simple_leveldb {
 
 	template < typename Key, class Comparator >
 	inline void skip_list< Key, Comparator >::iterator::seek_to_first() {
-		node_ = list_->head_->Next( 0 );
+		node_ = list_->head_->next( 0 );
 	}
 
 	template < typename Key, class Comparator >
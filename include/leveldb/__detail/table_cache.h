@@ -1,27 +1,75 @@
 #ifndef STORAGE_SIMPLE_LEVELDB_DB_TABLE_CACHE_H
 #define STORAGE_SIMPLE_LEVELDB_DB_TABLE_CACHE_H
 
+#include "leveldb/__detail/version_edit.h"
 #include "leveldb/cache.h"
 #include "leveldb/env.h"
+#include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
 #include <cstdint>
+#include <functional>
+#include <set>
+#include <vector>
 
 namespace simple_leveldb {
 
+	// Open table readers, keyed by file number.  Readers are opened without
+	// holding any lock shared between files, and concurrent requests for the
+	// same file wait for a single open instead of each opening it.
+	//
+	// Safe for concurrent use.
 	class table_cache {
 	private:
 		env* const         env_;
 		const core::string dbname_;
 		const options&     options_;
 		cache*             cache_;
+		const uint64_t     row_cache_id_;// Prefix of our keys in options_.row_cache
+
+		// mutex_ protects opening_, the files being opened right now.
+		port::mutex           mutex_;
+		port::cond_var        opened_cv_;// Signalled when an open finishes
+		core::set< uint64_t > opening_ GUARDED_BY( mutex_ );
+
+		status open_table( uint64_t file_number, uint64_t file_size, cache::handle** handle );
+		status get_from_table( const read_options& options, uint64_t file_number, uint64_t file_size,
+													 const slice& k,
+													 const core::function< void( const slice&, const slice& ) >& handle_result );
 
 	public:
+		// "entries" bounds the number of open readers; -1 means no bound, and
+		// readers stay open until their file is evicted.
 		table_cache( const core::string& dbname, const options& options, int32_t entries );
 		table_cache( const table_cache& )            = delete;
 		table_cache& operator=( const table_cache& ) = delete;
 		~table_cache();
 
 	public:
+		// Store a handle to the reader of the specified file in "*handle",
+		// opening the file if needed.  The caller must release() it.
+		status find_table( uint64_t file_number, uint64_t file_size, cache::handle** handle );
+		void   release( cache::handle* handle );
+
+		// Return an iterator over the specified file (whose length must be
+		// exactly "file_size" bytes).  The file's reader stays open until the
+		// iterator is deleted.
+		iterator* new_iterator( const read_options& options, uint64_t file_number, uint64_t file_size );
+
+		// If a seek to internal key "k" in specified file finds an entry,
+		// call handle_result(found_key, found_value).  With a row cache, an
+		// entry of another user key may be left out.
+		status get( const read_options& options, uint64_t file_number, uint64_t file_size, const slice& k,
+								const core::function< void( const slice&, const slice& ) >& handle_result );
+
+		// Open the readers of "files" on up to "threads" threads and wait for
+		// them.  Returns the first error.
+		status preload( const core::vector< file_meta_data* >& files, int32_t threads );
+
+		// Evict any entry for the specified file number
 		void evict( uint64_t file_number );
 	};
 
@@ -4,6 +4,7 @@
 #include "leveldb/__detail/db_format.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
+#include "leveldb/table_properties.h"
 #include <cstdint>
 #include <set>
 #include <string>
@@ -15,17 +16,20 @@ namespace simple_leveldb {
 	class version_set;
 
 	struct file_meta_data {
-		int32_t      refs;
-		int32_t      allowed_seeks;
-		uint64_t     number;
-		uint64_t     file_size;
-		internal_key smallest;
-		internal_key largest;
+		int32_t          refs;
+		int32_t          allowed_seeks;
+		uint64_t         number;
+		uint64_t         file_size;
+		internal_key     smallest;
+		internal_key     largest;
+		table_properties properties;// All zero if unknown (e.g. older manifests)
+		bool             being_compacted;// Input of a running compaction; guarded by the db mutex
 
 		file_meta_data()
 				: refs( 0 )
 				, allowed_seeks( 1 << 30 )
-				, file_size( 0 ) {}
+				, file_size( 0 )
+				, being_compacted( false ) {}
 	};
 
 	class version_edit {
@@ -66,7 +70,8 @@ namespace simple_leveldb {
 		status decode_from( const slice& src );
 
 		void add_file( int32_t level, uint64_t file, uint64_t file_size,
-									 const internal_key& smallest, const internal_key& largest );
+									 const internal_key& smallest, const internal_key& largest,
+									 const table_properties& properties = table_properties() );
 		void remove_file( int32_t level, uint64_t file );
 	};
 
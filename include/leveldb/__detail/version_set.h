@@ -4,11 +4,13 @@
 #include "leveldb/__detail/db_format.h"
 #include "leveldb/__detail/version_edit.h"
 #include "leveldb/env.h"
+#include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "port/port_stdcxx.h"
 #include <cstddef>
+#include <condition_variable>
 #include <cstdint>
 #include <set>
 #include <string>
@@ -37,9 +39,15 @@ namespace simple_leveldb {
 		core::vector< file_meta_data* > files_[ config::kNumLevels ];
 		file_meta_data*                 file_to_compact_;
 		int32_t                         file_to_compact_level_;
+		bool                            rewrite_file_to_compact_;// Picked by finalize() for its contents
 		double                          compaction_score_;
 		int32_t                         compaction_level_;
 
+		// Level that level 0 compacts into, and the size target of each
+		// level.  Set by version_set::finalize().
+		int32_t base_level_;
+		double  level_max_bytes_[ config::kNumLevels ];
+
 	public:
 		explicit version( version_set* vset );
 		version( const version& )            = delete;
@@ -49,6 +57,11 @@ namespace simple_leveldb {
 	public:
 		void ref();
 		void un_ref();
+
+		// Store in "*inputs" all files in "level" that overlap [begin,end].
+		// nullptr for "begin" or "end" means before all or after all keys.
+		void get_overlapping_inputs( int32_t level, const internal_key* begin, const internal_key* end,
+																 core::vector< file_meta_data* >* inputs );
 	};
 
 	class version_set {
@@ -73,10 +86,19 @@ namespace simple_leveldb {
 		version        dummy_versions_;// Head of circular doubly-linked list of versions.
 		version*       current_;       // == dummy_versions_.prev_
 
+		// log_any_apply() releases the mutex while it writes the MANIFEST, so
+		// background jobs finishing together take turns.
+		bool                         manifest_writing_;
+		core::condition_variable_any manifest_written_cv_;
+
 		// Per-level key at which the next compaction at that level should start.
 		// Either an empty string, or a valid InternalKey.
 		std::string compact_pointer_[ config::kNumLevels ];
 
+		// Compactions picked and not yet released.  Their inputs are marked
+		// being_compacted, and new picks must keep clear of them.
+		core::vector< compaction* > running_compactions_;
+
 	public:
 		struct level_summary_storage {
 			char buffer[ 100 ];
@@ -101,16 +123,45 @@ namespace simple_leveldb {
 
 		void        set_last_sequence( uint64_t );
 		void        add_live_files( core::set< uint64_t >* live );
+		void        get_current_files( core::vector< file_meta_data* >* files ) const;
 		void        mark_file_number_used( uint64_t number );
 		bool        needs_compaction() const;
+		// Pick a compaction that does not collide with any running one: no
+		// shared input files, and no overlapping key range in the same output
+		// level.  Returns nullptr if there is none.
 		compaction* pick_compaction();
-		compaction* compact_range( int32_t level, const internal_key* begin, const internal_key* end );
+
+		// Return a compaction of the files in "level" overlapping
+		// [begin,end], or nullptr if there are none.  Sets "*conflict", and
+		// returns nullptr, if they collide with a running compaction.
+		compaction* compact_range( int32_t level, const internal_key* begin, const internal_key* end,
+															 bool* conflict );
+
+		// Iterator over the inputs of "c", in internal key order.  Blocks it
+		// reads are not added to the block cache.
+		iterator* make_input_iterator( compaction* c );
 
 	private:
 		class builder;
 
 		bool   reuse_manifest( const core::string& dscname, const core::string& dscbase );
+		double level_score( const version* v, int32_t level ) const;
+		void   compute_level_targets( version* v ) const;
+		void   mark_file_for_compaction( version* v ) const;
 		void   finalize( version* v );
+
+		void        get_range( const core::vector< file_meta_data* >& inputs, internal_key* smallest,
+													 internal_key* largest );
+		void        get_range2( const core::vector< file_meta_data* >& inputs1,
+														const core::vector< file_meta_data* >& inputs2, internal_key* smallest,
+														internal_key* largest );
+		void        setup_other_inputs( compaction* c );
+		void        order_candidates( int32_t level, core::vector< file_meta_data* >* candidates ) const;
+		compaction* pick_level_compaction( int32_t level );
+		compaction* pick_universal_compaction( bool manual );
+		bool        claim_compaction( compaction* c );
+		void        add_running( compaction* c );
+		bool        conflicts_with_running( compaction* c );
 		status write_snap_shot( log::writer* log );
 		void   append_version( version* v );
 	};
@@ -121,16 +172,15 @@ namespace simple_leveldb {
 
 	private:
 		int32_t      level_;
+		int32_t      output_level_;
+		bool         has_older_runs_;// Older data for the input keys may exist outside the inputs
+		bool         must_rewrite_;  // Inputs are compacted for their contents; never just moved
 		uint64_t     max_output_file_size_;
 		version*     input_version_;
 		version_edit edit_;
 
 		core::vector< file_meta_data* > input_[ 2 ];
 		core::vector< file_meta_data* > grandparents_;
-		size_t                          grandparent_index_;
-		bool                            seen_key_;
-		int64_t                         overlapped_bytes_;
-		size_t                          level_ptrs[ config::kNumLevels ];
 
 	private:
 		compaction( const options* options, int32_t level );
@@ -138,17 +188,38 @@ namespace simple_leveldb {
 	public:
 		~compaction();
 
+	public:
+		// Where a pass over the inputs is, for should_stop_before() and
+		// is_base_level_for_key().  Each subcompaction keeps its own, so
+		// several can walk one compaction at once.
+		struct cursor {
+			size_t  grandparent_index                 = 0;
+			bool    seen_key                          = false;
+			int64_t overlapped_bytes                  = 0;
+			size_t  level_ptrs[ config::kNumLevels ] = {};
+		};
+
 	public:
 		int32_t         level() const;
+		int32_t         output_level() const;
 		version_edit*   edit();
 		int32_t         num_input_files( int32_t which ) const;
 		file_meta_data* input( int32_t which, int32_t i ) const;
 		uint64_t        max_output_file_size() const;
 		bool            is_trivial_move() const;
 		void            add_input_deletions( version_edit* edit );
-		bool            is_base_level_for_key( const slice& user_key );
-		bool            should_stop_before( const slice& internal_key );
+		bool            is_base_level_for_key( const slice& user_key, cursor* cursor ) const;
+		bool            is_bottommost_level() const;
+		bool            should_stop_before( const slice& internal_key, cursor* cursor ) const;
 		void            release_inputs();
+
+		// Split the key range of the inputs into at most "max_subcompactions"
+		// ranges holding about the same number of input bytes, and store the
+		// user keys between them in "*boundaries" (in order).  Range i holds
+		// the user keys in [(*boundaries)[i-1], (*boundaries)[i]).  Empty if
+		// the compaction is not worth splitting.
+		void get_subcompaction_boundaries( int32_t                       max_subcompactions,
+																			 core::vector< core::string >* boundaries ) const;
 	};
 }// namespace simple_leveldb
 
@@ -2,15 +2,55 @@
 #define STORAGE_SIMPEL_LEVELDB_INCLUDE_CACHE_H
 
 #include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <string>
 
 namespace simple_leveldb {
 
 	class cache;
+	class env;
 
-	cache* new_lru_cache( size_t capacity );
+	// Create a new cache with a fixed size capacity that evicts the least
+	// recently used entries.  Up to high_pri_pool_ratio of the capacity is
+	// reserved for entries inserted with priority::kHigh and for entries that
+	// have been looked up again; other entries are inserted at the midpoint
+	// and are evicted first.  A ratio of 0 gives plain LRU.
+	cache* new_lru_cache( size_t capacity, double high_pri_pool_ratio = 0.0 );
+
+	// Like new_lru_cache(), but with TinyLFU admission: every look_up() is
+	// counted in a small frequency sketch, and an insert that would evict
+	// the LRU victim is only cached if its key has been looked up more
+	// often than the victim's.  One-shot reads then cannot flush a stable
+	// hot set.  Rejected entries are still returned as usable handles; they
+	// are just not retained.
+	cache* new_tiny_lfu_cache( size_t capacity, double high_pri_pool_ratio = 0.0 );
+
+	// Create a two-tier cache.  Entries evicted from "primary" that were
+	// inserted with an item_helper are serialized, snappy compressed when the
+	// port supports it, and kept in a second in-memory tier of
+	// "secondary_capacity" bytes.  A look_up_item() that misses "primary" but
+	// hits the second tier rebuilds the value and moves it back to "primary",
+	// saving the disk read.  Takes ownership of "primary".
+	cache* new_compressed_tiered_cache( cache* primary, size_t secondary_capacity );
+
+	// Like new_compressed_tiered_cache(), but the second tier is a set of
+	// files under "dir", holding up to "capacity" bytes, on a device that is
+	// faster than the one holding the tables (e.g. local NVMe in front of
+	// network volumes).  The tier starts empty and its files are removed
+	// when the cache is deleted.  On success stores the cache, which owns
+	// "primary", in *result; on failure "primary" stays with the caller.
+	status new_persistent_tiered_cache( cache* primary, env* env, const core::string& dir,
+																			size_t capacity, cache** result );
+
+	// Create a cache that evicts with the CLOCK algorithm instead of LRU.
+	// Entries live in fixed open-addressed tables sized for roughly
+	// capacity / estimated_entry_charge entries, and look_up()/release() take
+	// no lock, so hot lookups scale across threads.  An estimate that is far
+	// too high leaves the cache short of slots before it is short of charge.
+	cache* new_clock_cache( size_t capacity, size_t estimated_entry_charge = 4 * 1024 );
 
 	class cache {
 	public:
@@ -21,15 +61,108 @@ namespace simple_leveldb {
 
 	public:
 		struct handle {};
-		virtual handle*  insert( const slice& key, void* value, size_t charge,
-														 core::function< void( const slice& key, void* value ) > deleter ) = 0;
-		virtual handle*  look_up( const slice& key )                                               = 0;
-		virtual void     release( handle* handle )                                                 = 0;
-		virtual void*    value( handle* handle )                                                   = 0;
-		virtual void     erase( const slice& key )                                                 = 0;
-		virtual uint64_t new_id()                                                                  = 0;
+
+		// Called with the key and value of an entry once it is out of the
+		// cache and unreferenced.  A plain function pointer rather than a
+		// closure, so an insert never allocates for it; state the deleter
+		// needs must be reachable from the value.
+		using deleter_type = void ( * )( const slice& key, void* value );
+
+		// Hint for caches that keep separate pools: kHigh entries, such as
+		// index and filter blocks, are the last to be evicted.  Caches without
+		// pools ignore it.
+		enum class priority {
+			kHigh,
+			kLow,
+		};
+
+		virtual handle*  insert( const slice& key, void* value, size_t charge, deleter_type deleter,
+														 priority priority = priority::kLow ) = 0;
+		virtual handle*  look_up( const slice& key )  = 0;
+		virtual void     release( handle* handle )    = 0;
+		virtual void*    value( handle* handle )      = 0;
+		virtual void     erase( const slice& key )    = 0;
+		virtual uint64_t new_id()                     = 0;
 		virtual void     prune() {}
 		virtual size_t   total_charge() const = 0;
+
+		// Charge "charge" bytes held outside the cache to it under "key", as an
+		// entry without a value (see cache_reservation).  Unlike insert(), this
+		// skips any admission policy.  Returns nullptr, and charges nothing, if
+		// the cache could not keep the entry.  Release the handle and erase the
+		// key to drop the charge.
+		virtual handle* insert_reservation( const slice& key, size_t charge ) = 0;
+
+		// How to move a value out of memory and back, for caches with tiers
+		// that hold entries as bytes (see new_compressed_tiered_cache()).
+		struct item_helper {
+			deleter_type deleter;
+
+			// The bytes that describe "value"; valid as long as "value" is.
+			slice ( *contents )( void* value );
+
+			// Build a new value from "contents", which is only valid during
+			// the call, and store its charge in "*charge".
+			void* ( *create )( const slice& contents, size_t* charge );
+		};
+
+		// Like insert() and look_up(), but let tiered caches spill the entry
+		// and rebuild it with "helper".  Single-tier caches just use
+		// helper->deleter.
+		virtual handle* insert_item( const slice& key, void* value, size_t charge,
+																 const item_helper* helper, priority priority = priority::kLow );
+		virtual handle* look_up_item( const slice& key, const item_helper* helper );
+
+		// Counters of a cache, of one of its shards, or of one block type.
+		// Counting is always on; it costs a few increments under locks the
+		// cache takes anyway.
+		struct stats {
+			uint64_t hits           = 0;
+			uint64_t misses         = 0;
+			uint64_t inserts        = 0;// Entries the cache kept
+			uint64_t evictions      = 0;// Entries dropped to make room for others
+			uint64_t failed_inserts = 0;// Entries the cache declined to keep
+			size_t   usage          = 0;// Charge of the entries in the cache
+			size_t   pinned_usage   = 0;// Part of usage that handles keep in use
+
+			void add( const stats& other );
+		};
+
+		// Number of independently locked parts of the cache, each with its
+		// own counters.
+		virtual int shard_count() const { return 1; }
+
+		// Store the counters of "shard", in [0, shard_count()), in "*stats".
+		// The default only knows the usage.
+		virtual void get_shard_stats( int shard, stats* stats ) const;
+
+		// Store the counters of the whole cache in "*stats".
+		void get_stats( stats* stats ) const;
+
+		// What a block cache entry holds.
+		enum class block_type {
+			kData,
+			kIndex,
+			kFilter,
+		};
+		static constexpr int kNumBlockTypes = 3;
+
+		// The cache cannot tell blocks apart, so table readers report each
+		// block access here.  Only hits, misses and inserts are kept per type,
+		// and inserts count what readers offered, whether the cache kept it.
+		void record_block_look_up( block_type type, bool hit );
+		void record_block_insert( block_type type );
+		void get_block_stats( block_type type, stats* stats ) const;
+
+	private:
+		// One cache line per type, as readers of all types update them.
+		struct alignas( 64 ) block_counters {
+			core::atomic< uint64_t > hits{ 0 };
+			core::atomic< uint64_t > misses{ 0 };
+			core::atomic< uint64_t > inserts{ 0 };
+		};
+
+		block_counters block_counters_[ kNumBlockTypes ];
 	};
 }// namespace simple_leveldb
 
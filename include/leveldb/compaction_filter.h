@@ -0,0 +1,57 @@
+#ifndef STORAGE_SIMPEL_LEVELDB_INCLUDE_COMPACTION_FILTER_H
+#define STORAGE_SIMPEL_LEVELDB_INCLUDE_COMPACTION_FILTER_H
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	// Lets compactions drop or rewrite values on the way through, e.g. to
+	// expire data without writing a delete for every key.
+	//
+	// A filter only sees the newest value of a key, and only once no
+	// snapshot can still read an older state of it.  Deletions are never
+	// passed to it.  Compactions run concurrently, so filter() must be safe
+	// to call from several threads at once.
+	class compaction_filter {
+	public:
+		struct context {
+			int32_t level;       // Level of the compaction's first inputs
+			int32_t output_level;// Level the outputs are written to
+			// True if no data for the compacted keys exists outside the
+			// inputs, i.e. the outputs hold the oldest values of these keys.
+			bool is_bottommost_level;
+		};
+
+		enum class decision {
+			kKeep,
+			kRemove,     // Drop the value; the key reads as not found
+			kChangeValue,// Replace the value by "*new_value"
+		};
+
+	public:
+		virtual ~compaction_filter();
+
+	public:
+		// The name of this filter.
+		virtual const char* name() const = 0;
+
+		virtual decision filter( const context& context, const slice& key, const slice& existing_value,
+														 core::string* new_value ) const = 0;
+	};
+
+	// Return a filter that removes values older than "ttl_seconds".  Values
+	// must end in their write time as a fixed32 (little-endian) number of
+	// seconds since the epoch, see append_ttl_timestamp(); shorter values
+	// are kept.  The suffix stays part of the value as read back.
+	const compaction_filter* new_ttl_compaction_filter( uint64_t ttl_seconds, env* env = env::Default() );
+
+	// Append the current time of "env" to "value" as expected by
+	// new_ttl_compaction_filter().
+	void append_ttl_timestamp( core::string* value, env* env = env::Default() );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPEL_LEVELDB_INCLUDE_COMPACTION_FILTER_H
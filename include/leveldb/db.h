@@ -40,6 +40,19 @@ namespace simple_leveldb {
 		// Returns OK on success, non-OK on failure.
 		// Note: consider setting options.sync = true.
 		virtual status Write( const write_options& options, write_batch* updates ) = 0;
+
+		// DB implementations can export properties about their state
+		// via this method.  If "property" is a valid property understood by this
+		// DB implementation, fills "*value" with its current value and returns
+		// true.  Otherwise returns false.
+		//
+		// Valid property names include:
+		//
+		//  "leveldb.block-cache-stats" - returns a multi-line string with the
+		//     hits, misses, inserts, evictions, failed inserts, usage and pinned
+		//     usage of the block cache, in total, per block type and per shard.
+		//     Not available if options::block_cache is nullptr.
+		virtual bool GetProperty( const slice& property, core::string* value ) = 0;
 	};
 
 }// namespace simple_leveldb
@@ -33,10 +33,29 @@ namespace simple_leveldb {
 	public:
 		static env* Default();
 
+		// Background thread pools.  kHigh runs short jobs that writers wait
+		// for (memtable flushes), kLow the long ones (compactions), so a
+		// flush never queues behind a compaction.
+		enum class priority {
+			kHigh,
+			kLow,
+		};
+
 		virtual status new_sequential_file( const core::string& fname, sequential_file** result )       = 0;
 		virtual status new_random_access_file( const core::string& fname, random_access_file** result ) = 0;
 		virtual status new_writable_file( const core::string& fname, writable_file** result )           = 0;
 		virtual status new_appendable_file( const core::string& fname, writable_file** result );
+
+		// Like new_random_access_file() and new_writable_file(), but the file
+		// bypasses the OS page cache (O_DIRECT).  Reads and writes are staged
+		// through aligned buffers, and a writable file only reaches the disk
+		// in whole aligned chunks, or on sync() and close().
+		//
+		// The default implementation returns not_supported, as does an env
+		// whose file system cannot do direct I/O; callers should then fall
+		// back to the buffered file (see open_random_access_file()).
+		virtual status new_direct_random_access_file( const core::string& fname, random_access_file** result );
+		virtual status new_direct_writable_file( const core::string& fname, writable_file** result );
 		virtual bool   file_exists( const core::string& fname )                                      = 0;
 		virtual status get_children( const core::string& dir, core::vector< core::string >* result ) = 0;
 		virtual status remove_file( const core::string& fname );
@@ -50,7 +69,17 @@ namespace simple_leveldb {
 		virtual status   rename_file( const core::string& src, const core::string& target ) = 0;
 		virtual status   lock_file( const core::string& fname, file_lock** lock )           = 0;
 		virtual status   unlock_file( file_lock* lock )                                     = 0;
-		virtual void     schedule( core::function< void( void* ) >&& func, void* args )     = 0;
+
+		// Arrange to run "func(args)" once on a thread of the "pri" pool.
+		// Jobs of one pool start in FIFO order and may run concurrently.
+		virtual void schedule( core::function< void( void* ) >&& func, void* args,
+													 priority pri = priority::kLow ) = 0;
+
+		// Set the number of threads of the "pri" pool (1 each by default).
+		// The default implementation ignores it.
+		virtual void    set_background_threads( int32_t number, priority pri );
+		virtual int32_t get_background_threads( priority pri );
+
 		virtual void     start_thread( core::function< void( void* ) >&& func, void* args ) = 0;
 		virtual status   get_test_directory( core::string* path )                           = 0;
 		virtual status   new_logger( const core::string& fname, logger** result )           = 0;
@@ -72,6 +101,16 @@ namespace simple_leveldb {
 		VIRTUAL_DEFAULT_DISABLE_COPY( random_access_file );
 
 		virtual status read( uint64_t offset, size_t n, slice* result, char* scratch ) const = 0;
+
+		// Returns true if read() ignores "scratch" and returns slices into
+		// memory owned by the file that stay valid until the file is deleted
+		// (e.g. an mmap'd file).  Callers may then pass a null "scratch" and
+		// keep the returned slices instead of copying them.
+		virtual bool reads_in_place() const;
+
+		// Hint that [offset, offset + n) will be read soon.  The default
+		// implementation does nothing.
+		virtual status will_need( uint64_t offset, size_t n );
 	};
 
 	class writable_file {
@@ -107,6 +146,14 @@ namespace simple_leveldb {
 	status write_string_to_file( env* env, const slice& data, const core::string& fname );
 	status write_string_to_file_sync( env* env, const slice& data, const core::string& fname );
 
+	// Open "fname" with the direct variant of the env call when
+	// "use_direct_io" is set, falling back to the buffered one if the env or
+	// the file system does not support direct I/O.
+	status open_random_access_file( env* env, const core::string& fname, bool use_direct_io,
+																	random_access_file** result );
+	status open_writable_file( env* env, const core::string& fname, bool use_direct_io,
+														 writable_file** result );
+
 	class env_wrapper : public env {
 	private:
 		env* target_;
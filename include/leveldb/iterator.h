@@ -0,0 +1,82 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_INCLUDE_ITERATOR_H
+#define STORAGE_SIMPLE_LEVELDB_INCLUDE_ITERATOR_H
+
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <functional>
+#include <vector>
+
+namespace simple_leveldb {
+
+	// An iterator yields a sequence of key/value pairs from a source.
+	// Multiple threads can invoke const methods on an iterator without
+	// external synchronization, but if any of the threads may call a
+	// non-const method, all threads accessing the same iterator must use
+	// external synchronization.
+	class iterator {
+	private:
+		core::vector< core::function< void() > > cleanups_;
+
+	public:
+		iterator() = default;
+		iterator( const iterator& )            = delete;
+		iterator& operator=( const iterator& ) = delete;
+		virtual ~iterator();
+
+	public:
+		// An iterator is either positioned at a key/value pair, or
+		// not valid.  This method returns true iff the iterator is valid.
+		virtual bool valid() const = 0;
+
+		// Position at the first key in the source.  The iterator is valid()
+		// after this call iff the source is not empty.
+		virtual void seek_to_first() = 0;
+
+		// Position at the last key in the source.  The iterator is
+		// valid() after this call iff the source is not empty.
+		virtual void seek_to_last() = 0;
+
+		// Position at the first key in the source that is at or past target.
+		// The iterator is valid() after this call iff the source contains
+		// an entry that comes at or past target.
+		virtual void seek( const slice& target ) = 0;
+
+		// Moves to the next entry in the source.  After this call, valid() is
+		// true iff the iterator was not positioned at the last entry in the source.
+		// REQUIRES: valid()
+		virtual void next() = 0;
+
+		// Moves to the previous entry in the source.  After this call, valid() is
+		// true iff the iterator was not positioned at the first entry in source.
+		// REQUIRES: valid()
+		virtual void prev() = 0;
+
+		// Return the key for the current entry.  The underlying storage for
+		// the returned slice is valid only until the next modification of
+		// the iterator.
+		// REQUIRES: valid()
+		virtual slice key() const = 0;
+
+		// Return the value for the current entry.  The underlying storage for
+		// the returned slice is valid only until the next modification of
+		// the iterator.
+		// REQUIRES: valid()
+		virtual slice value() const = 0;
+
+		// If an error has occurred, return it.  Else return an ok status.
+		virtual status get_status() const = 0;
+
+		// Clients are allowed to register functions that will be invoked
+		// when this iterator is destroyed, in registration order.
+		void register_cleanup( core::function< void() >&& func );
+	};
+
+	// Return an empty iterator (yields nothing).
+	iterator* new_empty_iterator();
+
+	// Return an empty iterator with the specified status.
+	iterator* new_error_iterator( const status& s );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_INCLUDE_ITERATOR_H
@@ -3,11 +3,56 @@
 
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/rate_limiter.h"
+#include <cstdint>
 
 namespace simple_leveldb {
 
+	enum class compaction_style {
+		// Levels of bounded size, each ten times larger than the one above.
+		// Reads touch few tables, but every key is rewritten about once per
+		// level.
+		kLevel,
+
+		// All tables stay in level 0 as sorted runs, and runs of similar size
+		// are merged into one.  Keys are rewritten far less often, at the cost
+		// of more tables per read and more space held by stale entries.
+		kUniversal,
+	};
+
+	// Which table of a level over its size target compaction_style::kLevel
+	// compacts next.
+	enum class compaction_pri {
+		// Cycle through the key space, starting after the end of the previous
+		// compaction of the level.
+		kRoundRobin,
+
+		// The table overlapping the fewest bytes of the next level relative
+		// to its own size, so each compaction rewrites as little of the next
+		// level as possible.  Lowers write amplification, most of all under
+		// skewed or sequential updates.
+		kMinOverlappingRatio,
+	};
+
+	// Options for compaction_style::kUniversal.  Each table in level 0 is a
+	// sorted run; runs are only ever merged with the runs newer than them.
+	struct compaction_options_universal {
+		// The newest runs are merged while the next older run is at most
+		// this many percent larger than all of them together.
+		uint32_t size_ratio = 1;
+
+		// Minimum and maximum number of runs merged by one compaction.
+		uint32_t min_merge_width = 2;
+		uint32_t max_merge_width = UINT32_MAX;
+
+		// Once the runs newer than the oldest add up to this many percent of
+		// its size, all runs are merged into one, dropping stale entries.
+		uint32_t max_size_amplification_percent = 200;
+	};
+
 	// Options to control the behavior of a database (passed to DB::Open)
 	struct options {
 		// Create an Options object with default values for all fields.
@@ -46,17 +91,158 @@ namespace simple_leveldb {
 
 		cache* block_cache = nullptr;
 
+		// If non-null, use the specified cache for the results of point
+		// lookups in table files, keyed by file number and user key.  A hit
+		// answers a lookup without opening the table or reading any block.
+		// Entries never go stale since table files are immutable.
+		cache* row_cache = nullptr;
+
+		// If true, memtable arenas and the index and filter memory that open
+		// tables pin are charged against block_cache's capacity, so that one
+		// number bounds all three.  Cached blocks are evicted to make room.
+		bool charge_memory_to_block_cache = false;
+
 		size_t block_size = 4 * 1024;
 
+		// Number of keys between restart points for delta encoding of keys.
+		// This parameter can be changed dynamically.  Most clients should
+		// leave this parameter alone.
+		int32_t block_restart_interval = 16;
+
+		// If true, each data block also carries a hash index from user key to
+		// restart interval, so point lookups skip the binary search over the
+		// restart array.  Costs about one byte per key per block.  Tables
+		// written without it remain readable.
+		bool data_block_hash_index = false;
+
+		// Target ratio of keys to buckets in the data block hash index.  Lower
+		// values mean fewer collisions and bigger blocks.
+		double data_block_hash_table_util_ratio = 0.75;
+
 		size_t write_buffer_size = 4 * 1024 * 1024;
 
+		// Maximum number of memtables, the active one included.  A full
+		// memtable is set aside for flushing and writes go on into a fresh
+		// one; writers only stall once this many are held in memory.  Raise
+		// it to absorb write bursts longer than one flush.
+		int32_t max_write_buffer_number = 2;
+
+		// Minimum number of full memtables that a flush waits for.  All that
+		// are waiting are flushed together into one level-0 table, keeping
+		// only the newest entry of each key, so flushing several at once
+		// writes fewer and smaller level-0 tables for overwrite-heavy loads.
+		// Capped at max_write_buffer_number - 1.
+		int32_t min_write_buffer_number_to_merge = 1;
+
+		// Number of open files that can be used by the DB.  You may need to
+		// increase this if your database has a large working set (budget
+		// one open file per 2MB of working set).
+		//
+		// -1 keeps every table open: all readers are opened in parallel by
+		// db::Open and stay open until their file is deleted, so no read
+		// ever waits for a table open.
 		int32_t max_open_files = 1000;
 
 		size_t max_file_size = 2 * 1024 * 1024;
 
+		// Maximum number of threads a single compaction is split across.  The
+		// inputs are cut at file boundaries into key ranges of about the same
+		// size, each compacted into its own output files, and all outputs are
+		// installed together.  Helps most with large level-0 compactions.
+		int32_t max_subcompactions = 1;
+
+		// Maximum number of compactions that may run at once.  Compactions
+		// only run together if they share no input files and do not write
+		// overlapping key ranges into the same level.  db::Open grows the
+		// env's kLow thread pool to this size if it is smaller.
+		int32_t max_background_compactions = 1;
+
+		// How compactions pick their inputs.  Universal compaction starts
+		// once level 0 holds 4 sorted runs.  A database can switch to it
+		// later, but tables already below level 0 then stay where they are.
+		simple_leveldb::compaction_style compaction_style = simple_leveldb::compaction_style::kLevel;
+
+		simple_leveldb::compaction_options_universal compaction_options_universal;
+
+		simple_leveldb::compaction_pri compaction_pri = simple_leveldb::compaction_pri::kRoundRobin;
+
+		// If true, level size targets are derived backwards from the size of
+		// the last level, each level ten times smaller than the one below.
+		// Levels whose target would drop below 10MB stay empty, and level 0
+		// compacts straight into the first level in use.  Keeps the ratio
+		// between levels, and so space amplification, steady as a database
+		// grows.  If false, level 1 holds 10MB and each level below ten times
+		// more.  Only affects compaction_style::kLevel.
+		bool level_compaction_dynamic_level_bytes = false;
+
+		// If positive, a table whose deletions make up at least this fraction
+		// of its entries is compacted on its own while no level is over its
+		// size target, so ranges dense with deletions are purged before scans
+		// keep stepping over them.  Tables of fewer than 128 entries are left
+		// alone.
+		double deletion_ratio_compaction_trigger = 0;
+
+		// If non-zero, a table written more than this many seconds ago is
+		// compacted on its own in the same way, so that compaction_filter
+		// eventually sees every key.
+		//
+		// Both triggers only affect compaction_style::kLevel and never pick
+		// tables in the last level.
+		uint64_t periodic_compaction_seconds = 0;
+
 		bool reuse_logs = false;
 
 		const filter_policy* filter_policy = nullptr;
+
+		// If non-null, compactions pass the newest value of each key through
+		// this filter, which may keep, remove or rewrite it.  Removed keys
+		// become deletions, or vanish once compacted into the bottommost
+		// level.  Memtable flushes do not call it.
+		const compaction_filter* compaction_filter = nullptr;
+
+		// If true, the index and filter of each table are split into partitions
+		// of roughly metadata_block_size bytes behind a small top-level index.
+		// Only the top-level index stays pinned while the table is open; the
+		// partitions are read through block_cache like data blocks.  This
+		// bounds the memory an open table pins regardless of its size.
+		bool partition_index_and_filters = false;
+
+		// Approximate size of an index or filter partition.  Only used when
+		// partition_index_and_filters is true.
+		size_t metadata_block_size = 4 * 1024;
+
+		// If true, table::open asks the OS to fault in the whole file ahead of
+		// use.  Only has an effect on files that read in place (mmap), which are
+		// always parsed without copying and bypass block_cache.
+		bool populate_mmapped_tables = false;
+
+		// If true, table files are read with O_DIRECT, bypassing the OS page
+		// cache; block_cache is then the only cache for table data.  Ignored
+		// where the env or the file system does not support direct I/O.
+		bool use_direct_reads = false;
+
+		// If true, tables written by memtable flushes and compactions are
+		// written with O_DIRECT so they do not evict hot pages from the OS
+		// page cache.  Ignored where direct I/O is not supported.
+		bool use_direct_io_for_flush_and_compaction = false;
+
+		// If non-null, writes of memtable flushes and compactions ask this
+		// limiter for their bytes first, flushes ahead of compactions.  Log
+		// and MANIFEST writes are never throttled.
+		rate_limiter* rate_limiter = nullptr;
+	};
+
+	// Options that control read operations
+	struct read_options {
+		read_options() = default;
+
+		// If true, all data read from underlying storage will be
+		// verified against corresponding checksums.
+		bool verify_checksums = false;
+
+		// Should the data read for this iteration be cached in memory?
+		// Callers may wish to set this field to false for bulk scans.
+		bool fill_cache = true;
 	};
 
 	struct write_options {
@@ -0,0 +1,53 @@
+#ifndef STORAGE_SIMPEL_LEVELDB_INCLUDE_RATE_LIMITER_H
+#define STORAGE_SIMPEL_LEVELDB_INCLUDE_RATE_LIMITER_H
+
+#include "leveldb/env.h"
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	// Caps the rate at which background jobs write to disk, so that flushes
+	// and compactions do not starve foreground reads and the WAL of I/O
+	// bandwidth.  Writers call request() before each write and block until
+	// the bytes are granted.  One limiter may be shared by several databases.
+	//
+	// Safe for concurrent use.
+	class rate_limiter {
+	public:
+		rate_limiter()                                 = default;
+		rate_limiter( const rate_limiter& )            = delete;
+		rate_limiter& operator=( const rate_limiter& ) = delete;
+		virtual ~rate_limiter();
+
+	public:
+		// Block until "bytes" may be written.  Waiting kHigh requests (memtable
+		// flushes) are granted before kLow ones (compactions).
+		virtual void request( int64_t bytes, env::priority pri ) = 0;
+
+		// Change the rate.  With auto-tuning this is the upper bound.
+		virtual void    set_bytes_per_second( int64_t bytes_per_second ) = 0;
+		virtual int64_t get_bytes_per_second() const                     = 0;
+
+		// Total bytes granted at "pri" since the limiter was created.
+		virtual int64_t get_total_bytes_through( env::priority pri ) const = 0;
+	};
+
+	// Return a token bucket that grants "bytes_per_second" in refills every
+	// "refill_period_us" microseconds.  Larger requests are split into
+	// pieces of one refill.  Unused bytes are not carried over beyond one
+	// period, so an idle limiter does not allow a burst later.
+	//
+	// If "auto_tuned" is true the rate moves between 1/20 of
+	// "bytes_per_second" and "bytes_per_second": it grows while writers
+	// keep draining the bucket, i.e. while compaction debt piles up, and
+	// shrinks back when they leave it mostly unused.
+	rate_limiter* new_generic_rate_limiter( int64_t bytes_per_second, int64_t refill_period_us = 100 * 1000,
+																					bool auto_tuned = false, env* env = env::Default() );
+
+	// Return a file that charges every append() to "limiter" at "pri" before
+	// passing it on to "base".  Takes ownership of "base".
+	writable_file* new_rate_limited_file( writable_file* base, rate_limiter* limiter, env::priority pri );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPEL_LEVELDB_INCLUDE_RATE_LIMITER_H
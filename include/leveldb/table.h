@@ -0,0 +1,69 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_H
+#define STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_H
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "leveldb/table_properties.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace simple_leveldb {
+
+	class iterator;
+	class random_access_file;
+
+	// A table is a sorted map from strings to strings.  Tables are
+	// immutable and persistent.  A table may be safely accessed from
+	// multiple threads without external synchronization.
+	class table {
+	private:
+		struct rep;
+		rep* const rep_;
+
+	public:
+		// Attempt to open the table that is stored in bytes [0..file_size)
+		// of "file", and read the metadata entries necessary to allow
+		// retrieving data from the table.
+		//
+		// If successful, returns ok and sets "*table" to the newly opened
+		// table.  The client should delete "*table" when no longer needed.
+		// If there was an error while initializing the table, sets "*table"
+		// to nullptr and returns a non-ok status.  Does not take ownership of
+		// "*file", but the client must ensure that "file" remains live
+		// for the duration of the returned table's lifetime.
+		static status open( const options& options, random_access_file* file, uint64_t file_size,
+												table** table );
+
+		table( const table& )            = delete;
+		table& operator=( const table& ) = delete;
+		~table();
+
+	public:
+		// Returns a new iterator over the table contents.  The result is
+		// initially invalid (caller must call one of the seek methods on the
+		// iterator before using it).
+		iterator* new_iterator( const read_options& options ) const;
+
+		// Calls "handle_result" with the first entry at or past "key", unless
+		// the filter proves that "key" is not in the table or "key" is past the
+		// last entry.
+		status internal_get( const read_options& options, const slice& key,
+												 const core::function< void( const slice& k, const slice& v ) >& handle_result );
+
+		// Bytes this table keeps in memory until it is deleted.
+		size_t pinned_memory_usage() const;
+
+		// Statistics recorded when the table was built.  All zero for tables
+		// written without a properties block.
+		const table_properties& properties() const;
+
+	private:
+		explicit table( rep* rep )
+				: rep_( rep ) {}
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_H
@@ -1,9 +1,82 @@
 #ifndef STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_BUILDER_H
 #define STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_BUILDER_H
 
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "leveldb/table_properties.h"
+#include <cstdint>
+
 namespace simple_leveldb {
 
-	class table_builder {};
+	class block_builder;
+	class block_handle;
+	class writable_file;
+
+	// table_builder provides the interface used to build a table
+	// (an immutable and sorted map from keys to values).
+	//
+	// Multiple threads can invoke const methods on a table_builder without
+	// external synchronization, but if any of the threads may call a
+	// non-const method, all threads accessing the same table_builder must use
+	// external synchronization.
+	class table_builder {
+	private:
+		struct rep;
+		rep* rep_;
+
+	public:
+		// Create a builder that will store the contents of the table it is
+		// building in *file.  Does not close the file.  It is up to the
+		// caller to close the file after calling finish().
+		table_builder( const options& options, writable_file* file );
+		table_builder( const table_builder& )            = delete;
+		table_builder& operator=( const table_builder& ) = delete;
+
+		// REQUIRES: Either finish() or abandon() has been called.
+		~table_builder();
+
+	public:
+		// Add key,value to the table being constructed.
+		// REQUIRES: key is after any previously added key according to comparator.
+		// REQUIRES: finish(), abandon() have not been called
+		void add( const slice& key, const slice& value );
+
+		// Advanced operation: flush any buffered key/value pairs to file.
+		// Can be used to ensure that two adjacent entries never live in
+		// the same data block.  Most clients should not need to use this method.
+		// REQUIRES: finish(), abandon() have not been called
+		void flush();
+
+		// Return non-ok iff some error has been detected.
+		status get_status() const;
+
+		// Finish building the table.  Stops using the file passed to the
+		// constructor after this function returns.
+		// REQUIRES: finish(), abandon() have not been called
+		status finish();
+
+		// Indicate that the contents of this builder should be abandoned.  Stops
+		// using the file passed to the constructor after this function returns.
+		// If the caller is not going to call finish(), it must call abandon()
+		// before destroying this builder.
+		// REQUIRES: finish(), abandon() have not been called
+		void abandon();
+
+		// Number of calls to add() so far.
+		uint64_t num_entries() const;
+
+		// Size of the file generated so far.  If invoked after a successful
+		// finish() call, returns the size of the final generated file.
+		uint64_t file_size() const;
+
+		// Statistics of the table.  Complete only after a successful finish().
+		const table_properties& properties() const;
+
+	private:
+		bool ok() const { return get_status().is_ok(); }
+		void write_block( block_builder* block, block_handle* handle );
+	};
 
 }// namespace simple_leveldb
 
@@ -0,0 +1,26 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H
+#define STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H
+
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	// Statistics gathered by table_builder while a table is written.  They
+	// are stored in the table's properties block and in the file's manifest
+	// entry, so callers can reason about a file without reading its data.
+	struct table_properties {
+		uint64_t num_entries    = 0;// Number of entries, including deletions
+		uint64_t num_deletions  = 0;// Number of deletion markers
+		uint64_t raw_key_size   = 0;// Total size of the keys as added
+		uint64_t raw_value_size = 0;// Total size of the values as added
+		uint64_t data_size      = 0;// Bytes of data blocks, including trailers
+		uint64_t index_size     = 0;// Bytes of index blocks, including trailers
+		uint64_t filter_size    = 0;// Bytes of filter blocks, including trailers
+		uint64_t smallest_seqno = 0;// Smallest sequence number of any entry
+		uint64_t largest_seqno  = 0;// Largest sequence number of any entry
+		uint64_t creation_time  = 0;// Seconds since the epoch when written; 0 if unknown
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H
@@ -1,10 +1,18 @@
 #ifndef STORAGE_SIMPEL_LEVELDB_PORT_STDCXX_H
 #define STORAGE_SIMPEL_LEVELDB_PORT_STDCXX_H
 
+#include "port/port_config.h"
 #include "port/thread_annotations.h"
 #include <cassert>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <mutex>
+#include <string>
+
+#if HAVE_SNAPPY
+#include <snappy.h>
+#endif// HAVE_SNAPPY
 
 namespace simple_leveldb::port {
 	namespace core = std;
@@ -53,6 +61,58 @@ namespace simple_leveldb::port {
 		void signal_all() { cv_.notify_all(); }
 	};
 
+	// Store the snappy compression of "input[0,length-1]" in *output.
+	// Returns false if snappy is not supported by this port.
+	inline bool Snappy_Compress( const char* input, size_t length, core::string* output ) {
+#if HAVE_SNAPPY
+		output->resize( snappy::MaxCompressedLength( length ) );
+		size_t outlen;
+		snappy::RawCompress( input, length, &( *output )[ 0 ], &outlen );
+		output->resize( outlen );
+		return true;
+#else
+		// Silence compiler warnings about unused arguments.
+		(void) input;
+		(void) length;
+		(void) output;
+		return false;
+#endif// HAVE_SNAPPY
+	}
+
+	// If input[0,input_length-1] looks like a valid snappy compressed
+	// buffer, store the size of the uncompressed data in *result and
+	// return true.  Else return false.
+	inline bool Snappy_GetUncompressedLength( const char* input, size_t length, size_t* result ) {
+#if HAVE_SNAPPY
+		return snappy::GetUncompressedLength( input, length, result );
+#else
+		// Silence compiler warnings about unused arguments.
+		(void) input;
+		(void) length;
+		(void) result;
+		return false;
+#endif// HAVE_SNAPPY
+	}
+
+	// Attempt to snappy uncompress input[0,input_length-1] into *output.
+	// Returns true if successful, false if the input is invalid snappy
+	// compressed data.
+	//
+	// REQUIRES: at least the first "n" bytes of output[] must be writable
+	// where "n" is the result of a successful call to
+	// Snappy_GetUncompressedLength.
+	inline bool Snappy_Uncompress( const char* input, size_t length, char* output ) {
+#if HAVE_SNAPPY
+		return snappy::RawUncompress( input, length, output );
+#else
+		// Silence compiler warnings about unused arguments.
+		(void) input;
+		(void) length;
+		(void) output;
+		return false;
+#endif// HAVE_SNAPPY
+	}
+
 	inline uint32_t AcceleratedCRC32C( uint32_t crc, const char* buf, size_t size ) {
 #if HAVE_CRC32C
 		return ::crc32c::Extend( crc, reinterpret_cast< const uint8_t* >( buf ), size );
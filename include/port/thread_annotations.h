@@ -21,4 +21,17 @@
 
 #endif
 
+// Other compilers do not check the annotations.
+#ifndef GUARDED_BY
+#define GUARDED_BY( x )
+#endif//!
+
+#ifndef PT_GUARDED_BY
+#define PT_GUARDED_BY( x )
+#endif//!
+
+#ifndef LOCKABLE
+#define LOCKABLE
+#endif//!
+
 #endif//! STORAGE_SIMPLE_LEVELDB_PORT_THREAD_ANNOTATIONS_H_
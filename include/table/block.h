@@ -0,0 +1,75 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_H
+
+#include "leveldb/cache.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/data_block_hash_index.h"
+#include "table/format.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	class comparator;
+
+	class block {
+	private:
+		class iter;
+
+		const char*           data_;
+		size_t                size_;
+		uint32_t              restart_offset_;// Offset in data_ of restart array
+		uint32_t              num_restarts_;
+		bool                  owned_;         // block owns data_[]
+		bool                  has_hash_index_;
+		data_block_hash_index hash_index_;
+
+	public:
+		// Initialize the block with the specified contents.
+		explicit block( const block_contents& contents );
+		block( const block& )            = delete;
+		block& operator=( const block& ) = delete;
+		~block();
+
+	public:
+		size_t    size() const { return size_; }
+		slice     data() const { return slice( data_, size_ ); }
+		iterator* new_iterator( const comparator* comparator );
+
+		// Return an iterator positioned as by seek( target ).  "target" must
+		// be an internal key; if the block has a hash index the iterator may
+		// instead be left invalid when the block holds no entry for its user
+		// key.
+		iterator* new_iterator_for_get( const comparator* comparator, const slice& target );
+	};
+
+	// Read the block identified by "handle" from "file".  When the table was
+	// opened with a block cache ("cache_id" != 0) the block is looked up in,
+	// and if read from disk and cachable, inserted into options.block_cache;
+	// "*cache_handle" then pins it and must be released by the caller.
+	// Otherwise "*cache_handle" is nullptr and the caller owns "*result".
+	// Index blocks are cached with priority::kHigh, and each access is
+	// counted under "type" (see cache::record_block_look_up()).
+	status fetch_block( const options& options, const read_options& read_options,
+											random_access_file* file, uint64_t cache_id, const block_handle& handle,
+											block** result, cache::handle** cache_handle,
+											cache::block_type type = cache::block_type::kData );
+
+	// Return an iterator over the block identified by "handle".  The block is
+	// fetched as by fetch_block() and unpinned when the iterator is deleted.
+	iterator* new_block_iterator( const options& options, const read_options& read_options,
+																random_access_file* file, uint64_t cache_id,
+																const block_handle& handle,
+																cache::block_type type = cache::block_type::kData );
+
+	// Like new_block_iterator(), but positioned for a point lookup of
+	// "target" as by block::new_iterator_for_get().
+	iterator* new_block_iterator_for_get( const options& options, const read_options& read_options,
+																				random_access_file* file, uint64_t cache_id,
+																				const block_handle& handle, const slice& target );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_H
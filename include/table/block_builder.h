@@ -0,0 +1,55 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_BUILDER_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_BUILDER_H
+
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "table/data_block_hash_index.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simple_leveldb {
+
+	class block_builder {
+	private:
+		const options*           options_;
+		core::string             buffer_;  // Destination buffer
+		core::vector< uint32_t > restarts_;// Restart points
+		int32_t                  counter_; // Number of entries emitted since restart
+		bool                     finished_;// Has finish() been called?
+		core::string             last_key_;
+
+		bool                          use_hash_index_;
+		data_block_hash_index_builder hash_index_builder_;
+
+	public:
+		// If "use_hash_index" is true, keys must be internal keys and a hash
+		// index over their user keys is appended to the block when it fits.
+		explicit block_builder( const options* options, bool use_hash_index = false );
+		block_builder( const block_builder& )            = delete;
+		block_builder& operator=( const block_builder& ) = delete;
+
+	public:
+		// Reset the contents as if the block_builder was just constructed.
+		void reset();
+
+		// REQUIRES: finish() has not been called since the last call to reset().
+		// REQUIRES: key is larger than any previously added key
+		void add( const slice& key, const slice& value );
+
+		// Finish building the block and return a slice that refers to the
+		// block contents.  The returned slice will remain valid for the
+		// lifetime of this builder or until reset() is called.
+		slice finish();
+
+		// Returns an estimate of the current (uncompressed) size of the block
+		// we are building.
+		size_t current_size_estimate() const;
+
+		// Return true iff no entries have been added since the last reset()
+		bool empty() const { return buffer_.empty(); }
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_BLOCK_BUILDER_H
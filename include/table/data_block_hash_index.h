@@ -0,0 +1,86 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H
+
+#include "leveldb/slice.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace simple_leveldb {
+
+	// A data block hash index maps the user keys of a data block to the
+	// restart interval that holds them, so a point lookup can skip the binary
+	// search over the restart array.  It is appended to the block, between
+	// the restart array and the trailing restart count:
+	//
+	//     buckets: uint8[num_buckets]
+	//     num_buckets: uint16
+	//
+	// Each bucket holds a restart index, kNoEntry if no user key hashes to it,
+	// or kCollision if keys from different restart intervals do.  Because a
+	// bucket is one byte, blocks with more than kMaxRestartSupportedByHashIndex
+	// restart points are written without an index.  A block that carries an
+	// index has kDataBlockHashIndexFlag set in its trailing restart count.
+	const uint8_t  kNoEntry                        = 255;
+	const uint8_t  kCollision                      = 254;
+	const uint8_t  kMaxRestartSupportedByHashIndex = 253;
+	const uint32_t kDataBlockHashIndexFlag         = 1u << 31;
+
+	class data_block_hash_index_builder {
+	private:
+		bool                                            valid_;
+		double                                          bucket_per_key_;// 1 / util_ratio
+		double                                          estimated_num_buckets_;
+		core::vector< core::pair< uint32_t, uint8_t > > hash_and_restart_pairs_;
+
+	public:
+		data_block_hash_index_builder()
+				: valid_( false )
+				, bucket_per_key_( -1 )
+				, estimated_num_buckets_( 0 ) {}
+
+	public:
+		// Aim for "util_ratio" keys per bucket.  The builder stays invalid, and
+		// add() is a no-op, until this is called with a ratio > 0.
+		void initialize( double util_ratio );
+
+		void add( const slice& user_key, size_t restart_index );
+
+		// Append the index to "buffer".  REQUIRES: valid()
+		void finish( core::string& buffer );
+
+		void reset();
+
+		// Number of bytes finish() would append right now.
+		size_t estimate_size() const;
+
+		inline bool valid() const { return valid_ && bucket_per_key_ > 0; }
+	};
+
+	class data_block_hash_index {
+	private:
+		const char* buckets_;
+		uint16_t    num_buckets_;
+
+	public:
+		data_block_hash_index()
+				: buckets_( nullptr )
+				, num_buckets_( 0 ) {}
+
+	public:
+		// "data[0, size)" ends with an index written by the builder.  Returns
+		// false if it is malformed; otherwise sets "*map_offset" to the offset
+		// of the first bucket, which is where the restart array ends.
+		bool initialize( const char* data, size_t size, size_t* map_offset );
+
+		// Returns the restart index for "user_key", kNoEntry or kCollision.
+		uint8_t lookup( const slice& user_key ) const;
+
+		inline uint16_t num_buckets() const { return num_buckets_; }
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_DATA_BLOCK_HASH_INDEX_H
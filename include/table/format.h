@@ -0,0 +1,123 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_FORMAT_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_FORMAT_H
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	// DO NOT CHANGE THESE ENUM VALUES: they are embedded in the on-disk
+	// data structures.
+	enum class compression_type : uint8_t {
+		kNoCompression = 0x0,
+	};
+
+	// Layout of the index stored in a table.  Recorded in the metaindex
+	// block under kIndexTypeKey; tables without the entry use kBinarySearch.
+	enum class index_type : uint8_t {
+		// A single index block mapping a separator key to each data block.
+		kBinarySearch = 0x0,
+		// A top-level index mapping a separator key to each index partition.
+		kTwoLevelIndexSearch = 0x1,
+	};
+
+	// Metaindex keys of the blocks written by table_builder.
+	static const char kIndexTypeKey[]            = "simple_leveldb.index_type";
+	static const char kPropertiesBlockKey[]      = "simple_leveldb.properties";
+	static const char kFullFilterPrefix[]        = "fullfilter.";
+	static const char kPartitionedFilterPrefix[] = "partitionedfilter.";
+
+	// block_handle is a pointer to the extent of a file that stores a data
+	// block or a meta block.
+	class block_handle {
+	private:
+		uint64_t offset_;
+		uint64_t size_;
+
+	public:
+		// Maximum encoding length of a block_handle
+		enum { kMaxEncodedLength = 10 + 10 };
+
+	public:
+		block_handle();
+
+	public:
+		// The offset of the block in the file.
+		uint64_t offset() const { return offset_; }
+		void     set_offset( uint64_t offset ) { offset_ = offset; }
+
+		// The size of the stored block
+		uint64_t size() const { return size_; }
+		void     set_size( uint64_t size ) { size_ = size; }
+
+		void   encode_to( core::string* dst ) const;
+		status decode_from( slice* input );
+	};
+
+	// footer encapsulates the fixed information stored at the tail
+	// end of every table file.
+	class footer {
+	private:
+		block_handle metaindex_handle_;
+		block_handle index_handle_;
+
+	public:
+		// Encoded length of a footer.  Note that the serialization of a
+		// footer will always occupy exactly this many bytes.  It consists
+		// of two block handles and a magic number.
+		enum { kEncodedLength = 2 * block_handle::kMaxEncodedLength + 8 };
+
+	public:
+		footer() = default;
+
+	public:
+		// The block handle for the metaindex block of the table
+		const block_handle& metaindex_handle() const { return metaindex_handle_; }
+		void                set_metaindex_handle( const block_handle& h ) { metaindex_handle_ = h; }
+
+		// The block handle for the index block of the table.  For a
+		// partitioned index this is the top-level index.
+		const block_handle& index_handle() const { return index_handle_; }
+		void                set_index_handle( const block_handle& h ) { index_handle_ = h; }
+
+		void   encode_to( core::string* dst ) const;
+		status decode_from( slice* input );
+	};
+
+	// kTableMagicNumber was picked by running
+	//    echo http://code.google.com/p/leveldb/ | sha1sum
+	// and taking the leading 64 bits.
+	static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
+
+	// 1-byte type + 32-bit crc
+	static const size_t kBlockTrailerSize = 5;
+
+	struct block_contents {
+		slice data;          // Actual contents of data
+		bool  cachable;      // True iff data can be cached
+		bool  heap_allocated;// True iff caller should delete[] data.data()
+	};
+
+	// Read the block identified by "handle" from "file".  On failure
+	// return non-OK.  On success fill *result and return OK.
+	status read_block( random_access_file* file, const read_options& options,
+										 const block_handle& handle, block_contents* result );
+
+	// Append "contents" followed by the block trailer to "file" at "*offset",
+	// advance "*offset" past the trailer and point "*handle" at the block.
+	status write_raw_block( writable_file* file, const slice& contents, compression_type type,
+													uint64_t* offset, block_handle* handle );
+
+	// Implementation details follow.  Clients should ignore,
+
+	inline block_handle::block_handle()
+			: offset_( ~static_cast< uint64_t >( 0 ) )
+			, size_( ~static_cast< uint64_t >( 0 ) ) {}
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_FORMAT_H
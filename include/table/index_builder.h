@@ -0,0 +1,90 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_BUILDER_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_BUILDER_H
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace simple_leveldb {
+
+	// index_builder produces the index and the filter of a table.
+	//
+	// Without options::partition_index_and_filters it builds one index block
+	// with an entry per data block and one filter over every key of the table.
+	//
+	// With partitioning the index entries are cut into partitions of about
+	// options::metadata_block_size bytes.  The filter is cut at the same keys,
+	// so index partition i and filter partition i cover the same data blocks.
+	// finish() writes every partition followed by a top-level block that maps
+	// the last separator of each partition to its handle; only the top-level
+	// blocks need to stay in memory while the table is open.
+	class index_builder {
+	private:
+		struct partition {
+			core::string separator;// Last separator key of the partition
+			core::string index;    // Finished index block contents
+			core::string filter;   // Finished filter contents, if any
+		};
+
+		const options*            options_;
+		options                   index_block_options_;
+		const bool                partitioned_;
+		block_builder             index_block_;    // Current partition, or the whole index
+		core::string              last_separator_; // Last key added to index_block_
+		core::vector< partition > partitions_;     // Partitions cut so far
+		core::string              keys_;           // Flattened filter key contents
+		core::vector< size_t >    start_;          // Starting index in keys_ of each key
+		core::vector< slice >     tmp_keys_;       // policy->create_filter() argument
+		uint64_t                  index_size_;     // Bytes written by finish() for the index
+		uint64_t                  filter_size_;    // Bytes written by finish() for the filter
+
+	public:
+		explicit index_builder( const options* options );
+		index_builder( const index_builder& )            = delete;
+		index_builder& operator=( const index_builder& ) = delete;
+
+	public:
+		// Remember "key" for the filter of the current partition.
+		void add_key( const slice& key );
+
+		// Add an index entry for the data block at "handle", whose last key is
+		// "*last_key_in_current_block".  The key is shortened in place to a
+		// separator that is < "*first_key_in_next_block", or to a short
+		// successor when "first_key_in_next_block" is nullptr (last block).
+		void add_index_entry( core::string* last_key_in_current_block,
+													const slice* first_key_in_next_block, const block_handle& handle );
+
+		// Write the filter and the index to "file" at "*offset".  On success
+		// "*index_handle" points at the index (the top-level index when
+		// partitioned) and "*filter_handle" at the filter (likewise), or has
+		// a zero size when no filter policy is configured.
+		status finish( writable_file* file, uint64_t* offset, block_handle* index_handle,
+									 block_handle* filter_handle );
+
+		// How finish() lays out the index.
+		index_type type() const;
+
+		// Bytes finish() wrote for the index and the filter, including block
+		// trailers and, when partitioned, the top-level blocks.
+		uint64_t index_size() const { return index_size_; }
+		uint64_t filter_size() const { return filter_size_; }
+
+	private:
+		void         cut_partition();
+		core::string generate_filter();
+		status       write_index_block( writable_file* file, const slice& contents, uint64_t* offset,
+																		block_handle* handle );
+		status       write_filter_block( writable_file* file, const slice& contents, uint64_t* offset,
+																		 block_handle* handle );
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_BUILDER_H
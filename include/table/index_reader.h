@@ -0,0 +1,71 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_READER_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_READER_H
+
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "table/block.h"
+#include "table/format.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	// index_reader answers index and filter queries for an open table.
+	//
+	// For a kBinarySearch table the whole index block and the full filter are
+	// pinned.  For a kTwoLevelIndexSearch table only the top-level index and
+	// the top-level filter index are pinned; partitions are fetched through
+	// options::block_cache exactly like data blocks.
+	class index_reader {
+	private:
+		const options&            options_;
+		random_access_file* const file_;
+		const uint64_t            cache_id_;
+		const index_type          type_;
+		block*                    index_block_; // Whole index, or top-level index
+		block*                    filter_index_;// Top-level filter index, if partitioned
+		block_contents            filter_;      // Full filter, if not partitioned
+
+	public:
+		// Read the pinned part of the index at "index_handle" and of the filter
+		// at "filter_handle" (zero size if the table has none).  "options" must
+		// outlive the reader.
+		static status open( const options& options, random_access_file* file, uint64_t cache_id,
+												index_type type, const block_handle& index_handle,
+												const block_handle& filter_handle, index_reader** reader );
+
+		index_reader( const index_reader& )            = delete;
+		index_reader& operator=( const index_reader& ) = delete;
+		~index_reader();
+
+	public:
+		// Point "*handle" at the data block that may contain "key".  Returns
+		// not_found if "key" is past the last key of the table.
+		status find_data_block( const read_options& read_options, const slice& key,
+														block_handle* handle );
+
+		// Return an iterator over the index: the last key of each data block
+		// mapped to the encoded handle of the block.  Index partitions are
+		// fetched with "read_options" as the iterator reaches them.
+		iterator* new_index_iterator( const read_options& read_options );
+
+		// Return false iff the filter proves "key" is not in the table.
+		bool key_may_match( const read_options& read_options, const slice& key );
+
+		// Bytes held in memory for as long as the table is open.
+		size_t pinned_memory_usage() const;
+
+	private:
+		index_reader( const options& options, random_access_file* file, uint64_t cache_id,
+									index_type type );
+
+		bool partition_may_match( const read_options& read_options, const block_handle& handle,
+															const slice& key );
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_INDEX_READER_H
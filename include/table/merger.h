@@ -0,0 +1,23 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_MERGER_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_MERGER_H
+
+#include "leveldb/iterator.h"
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	class comparator;
+
+	// Return an iterator that provided the union of the data in
+	// children[0,n-1].  Takes ownership of the child iterators and
+	// will delete them when the result iterator is deleted.
+	//
+	// The result does no duplicate suppression.  I.e., if a particular
+	// key is present in K child iterators, it will be yielded K times.
+	//
+	// REQUIRES: n >= 0
+	iterator* new_merging_iterator( const comparator* comparator, iterator** children, int32_t n );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_MERGER_H
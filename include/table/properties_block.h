@@ -0,0 +1,28 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_PROPERTIES_BLOCK_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_PROPERTIES_BLOCK_H
+
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "leveldb/status.h"
+#include "leveldb/table_properties.h"
+#include "table/format.h"
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	// The properties block is a block keyed by property name (see
+	// properties_block.cc) whose values are varint64s.  Unknown names are
+	// skipped on read and missing ones keep their default, so fields can be
+	// added without breaking old tables.
+
+	// Write "props" as a properties block to "file" at "*offset".
+	status write_properties_block( writable_file* file, const table_properties& props,
+																 uint64_t* offset, block_handle* handle );
+
+	// Read the properties block at "handle" into "*props".
+	status read_properties_block( random_access_file* file, const read_options& options,
+																const block_handle& handle, table_properties* props );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_PROPERTIES_BLOCK_H
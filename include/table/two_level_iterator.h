@@ -0,0 +1,24 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H
+#define STORAGE_SIMPLE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H
+
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+#include <functional>
+
+namespace simple_leveldb {
+
+	// Return a new two level iterator.  A two-level iterator contains an
+	// index iterator whose values point to a sequence of blocks where
+	// each block is itself a sequence of key,value pairs.  The returned
+	// two-level iterator yields the concatenation of all key/value pairs
+	// in the sequence of blocks.  Takes ownership of "index_iter" and
+	// will delete it when no longer needed.
+	//
+	// Uses "block_function" to convert an index_iter value into an
+	// iterator over the contents of the corresponding block.
+	iterator* new_two_level_iterator( iterator*                                           index_iter,
+																		core::function< iterator*( const slice& index_value ) > block_function );
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_TABLE_TWO_LEVEL_ITERATOR_H
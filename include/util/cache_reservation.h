@@ -0,0 +1,59 @@
+#ifndef STORAGE_SIMPLE_LEVELDB_UTIL_CACHE_RESERVATION_H
+#define STORAGE_SIMPLE_LEVELDB_UTIL_CACHE_RESERVATION_H
+
+#include "leveldb/cache.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace simple_leveldb {
+
+	// Charges memory that a cache does not hold against the cache's capacity,
+	// so one capacity bounds both.  The reservation is a set of pinned entries
+	// without values whose charges add up to the reserved size; inserting
+	// them evicts unpinned entries as any insert would, but bypasses admission
+	// (see cache::insert_reservation()).  If the cache cannot keep an entry,
+	// e.g. because every slot is pinned, reserved() stays below the request.
+	//
+	// The reservation grows in steps of "step" bytes, so callers can
+	// update() on every allocation cheaply.  A step of 1 reserves exactly.
+	//
+	// Not thread-safe.
+	class cache_reservation {
+	public:
+		static const size_t kDefaultStep = 256 * 1024;
+
+		// A nullptr "cache" makes every call a no-op.
+		explicit cache_reservation( cache* cache, size_t step = kDefaultStep );
+
+		cache_reservation( const cache_reservation& )            = delete;
+		cache_reservation& operator=( const cache_reservation& ) = delete;
+
+		~cache_reservation();
+
+		// Reserve "bytes", rounded up to a multiple of the step.
+		void update( size_t bytes );
+
+		size_t reserved() const { return reserved_; }
+
+	private:
+		struct entry {
+			cache::handle* handle;
+			size_t         charge;
+			uint64_t       sequence;
+		};
+
+		void make_key( uint64_t sequence, char* key ) const;
+		void release_last();
+
+		cache* const          cache_;
+		const size_t          step_;
+		const uint64_t        id_;// Keys are id_ plus a sequence number
+		uint64_t              next_sequence_;
+		size_t                reserved_;
+		core::vector< entry > entries_;
+	};
+
+}// namespace simple_leveldb
+
+#endif//! STORAGE_SIMPLE_LEVELDB_UTIL_CACHE_RESERVATION_H
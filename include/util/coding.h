@@ -25,6 +25,9 @@ namespace simple_leveldb {
 	char* encode_varint32( char* dst, uint32_t value );
 	char* encode_varint64( char* dst, uint64_t value );
 
+	// Returns the length of the varint32 or varint64 encoding of "v"
+	int32_t varint_length( uint64_t v );
+
 	static inline uint32_t decode_fixed32( const char* ptr );
 	static inline uint64_t decode_fixed64( const char* ptr );
 
@@ -13,6 +13,24 @@ namespace simple_leveldb {
 		return ( seq << 8 ) | static_cast< int8_t >( t );
 	}
 
+	void append_internal_key( core::string* result, const parsed_internal_key& key ) {
+		result->append( key.user_key.data(), key.user_key.size() );
+		put_fixed64( result, pack_sequence_and_type( key.sequence, key.type ) );
+	}
+
+	bool parse_internal_key( const slice& internal_key, parsed_internal_key* result ) {
+		const size_t n = internal_key.size();
+		if ( n < 8 ) {
+			return false;
+		}
+		const uint64_t num = decode_fixed64( internal_key.data() + n - 8 );
+		const uint8_t  c   = num & 0xff;
+		result->sequence   = num >> 8;
+		result->type       = static_cast< value_type >( c );
+		result->user_key   = slice( internal_key.data(), n - 8 );
+		return c <= static_cast< uint8_t >( value_type::kTypeValue );
+	}
+
 	const char* internal_key_comparator::name() const {
 		return "simple_leveldb.InternalKeyComparator";
 	}
@@ -81,6 +99,10 @@ namespace simple_leveldb {
 		return rep_;
 	}
 
+	slice internal_key::user_key() const { return extract_user_key( rep_ ); }
+
+	void internal_key::clear() { rep_.clear(); }
+
 	bool internal_key::decode_from( const slice& s ) {
 		rep_.assign( s.data(), s.size() );
 		return !rep_.empty();
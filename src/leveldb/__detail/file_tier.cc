@@ -0,0 +1,303 @@
+#include "leveldb/__detail/secondary_tier.h"
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/mutex_lock.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace simple_leveldb {
+
+	namespace {
+
+		// File tier layout
+		//
+		// Records are appended to an in-memory buffer of up to file_size_ bytes.
+		// When the next record does not fit, the buffer is sealed and written
+		// out in one go as "<dir>/<number>.cache", then read back through a
+		// random_access_file.  Until the write completes, reads are served from
+		// the sealed buffer.  Once there are more than max_files_ sealed files
+		// the oldest is dropped with all its records, so eviction is FIFO by
+		// file.  Records that are erased or replaced stay behind as dead space
+		// until their file is dropped.  Promoted records are kept, so a block
+		// that bounces between the primary and this tier is written only once.
+		//
+		// record := masked crc32c (fixed32)
+		//           key size (fixed32)
+		//           data size (fixed32)
+		//           key
+		//           data
+		//
+		// The crc covers everything after itself.  It is checked on every read,
+		// and a record that fails the check is dropped from the index.
+		static const size_t kHeaderSize = 12;
+
+		static core::string cache_file_name( const core::string& dir, uint64_t number ) {
+			char buf[ 100 ];
+			core::snprintf( buf, sizeof buf, "/%06llu.cache",
+											static_cast< unsigned long long >( number ) );
+			return dir + buf;
+		}
+
+		static bool is_cache_file_name( const core::string& name ) {
+			static const char   kSuffix[]   = ".cache";
+			static const size_t kSuffixSize = sizeof( kSuffix ) - 1;
+			return name.size() > kSuffixSize &&
+						 name.compare( name.size() - kSuffixSize, kSuffixSize, kSuffix ) == 0;
+		}
+
+		class file_tier : public secondary_tier {
+		private:
+			// Where the latest record of a key lives.
+			struct location {
+				uint64_t number;
+				uint64_t offset;
+				uint32_t size;// Of the whole record
+			};
+
+			struct sealed_file {
+				core::shared_ptr< const core::string > buffer;// Contents until written out
+				core::shared_ptr< random_access_file > file;  // Set once written out
+				core::vector< core::string >           keys;  // Keys with records here
+			};
+
+			env* const         env_;
+			const core::string dir_;
+			const size_t       file_size_;
+			const size_t       max_files_;
+
+			// mutex_ protects the following state.  It is not held during file I/O.
+			mutable port::mutex                           mutex_;
+			core::unordered_map< core::string, location > index_ GUARDED_BY( mutex_ );
+			core::map< uint64_t, sealed_file >            sealed_ GUARDED_BY( mutex_ );// Oldest first
+			uint64_t                                      active_number_ GUARDED_BY( mutex_ );
+			core::string                                  active_ GUARDED_BY( mutex_ );
+			core::vector< core::string >                  active_keys_ GUARDED_BY( mutex_ );
+
+			// Remove the records of sealed file "it" and the file itself.
+			// REQUIRES: mutex_ held
+			void drop( core::map< uint64_t, sealed_file >::iterator it ) {
+				for ( const core::string& key: it->second.keys ) {
+					auto x = index_.find( key );
+					if ( x != index_.end() && x->second.number == it->first ) {
+						index_.erase( x );
+					}
+				}
+				if ( it->second.file != nullptr ) {
+					env_->remove_file( cache_file_name( dir_, it->first ) );
+				}
+				sealed_.erase( it );
+			}
+
+			// Move the active buffer to sealed_ and write it out.  Releases
+			// mutex_ during the write.
+			// REQUIRES: mutex_ held
+			void seal() {
+				const uint64_t number = active_number_;
+				sealed_file&   f      = sealed_[ number ];
+				auto           buffer = core::make_shared< const core::string >( core::move( active_ ) );
+				f.buffer              = buffer;
+				f.keys                = core::move( active_keys_ );
+				active_.clear();
+				active_keys_.clear();
+				active_number_++;
+				while ( sealed_.size() > max_files_ ) {
+					drop( sealed_.begin() );
+				}
+
+				const core::string  fname = cache_file_name( dir_, number );
+				random_access_file* file  = nullptr;
+				mutex_.unlock();
+				status s = write_string_to_file( env_, *buffer, fname );
+				if ( s.is_ok() ) {
+					s = env_->new_random_access_file( fname, &file );
+				}
+				mutex_.lock();
+
+				auto it = sealed_.find( number );
+				if ( it == sealed_.end() ) {
+					// Dropped while we were writing it.
+					delete file;
+					env_->remove_file( fname );
+				} else if ( !s.is_ok() ) {
+					it->second.buffer.reset();
+					drop( it );
+					env_->remove_file( fname );
+				} else {
+					it->second.file.reset( file );
+					it->second.buffer.reset();
+				}
+			}
+
+			// Check "record" and extract its data.
+			static bool parse_record( const slice& key, const slice& record, core::string* data ) {
+				if ( record.size() < kHeaderSize ) {
+					return false;
+				}
+				const char*    p          = record.data();
+				const uint32_t crc        = crc32c::Unmask( decode_fixed32( p ) );
+				const uint32_t key_size   = decode_fixed32( p + 4 );
+				const uint32_t data_size  = decode_fixed32( p + 8 );
+				const uint64_t total_size = kHeaderSize + uint64_t{ key_size } + data_size;
+				if ( total_size != record.size() ||
+						 crc32c::Value( p + 4, record.size() - 4 ) != crc ||
+						 slice( p + kHeaderSize, key_size ) != key ) {
+					return false;
+				}
+				data->assign( p + kHeaderSize + key_size, data_size );
+				return true;
+			}
+
+			// Forget "key" if its latest record is still at "loc".
+			void erase_if_at( const slice& key, const location& loc ) {
+				MutexLock l( &mutex_ );
+				auto      x = index_.find( key.to_string() );
+				if ( x != index_.end() && x->second.number == loc.number && x->second.offset == loc.offset ) {
+					index_.erase( x );
+				}
+			}
+
+		public:
+			file_tier( env* env, const core::string& dir, size_t capacity, size_t file_size )
+					: env_( env )
+					, dir_( dir )
+					, file_size_( file_size )
+					, max_files_( core::max< size_t >( 1, capacity / file_size ) )
+					, active_number_( 1 ) {}
+
+			~file_tier() override { prune(); }
+
+			void insert( const slice& key, const slice& data ) override {
+				const size_t size = kHeaderSize + key.size() + data.size();
+				if ( size > file_size_ ) {
+					return;
+				}
+				core::string record;
+				record.reserve( size );
+				put_fixed32( &record, 0 );// Placeholder for the crc
+				put_fixed32( &record, static_cast< uint32_t >( key.size() ) );
+				put_fixed32( &record, static_cast< uint32_t >( data.size() ) );
+				record.append( key.data(), key.size() );
+				record.append( data.data(), data.size() );
+				encode_fixed32( &record[ 0 ], crc32c::Mask( crc32c::Value( record.data() + 4, size - 4 ) ) );
+
+				MutexLock l( &mutex_ );
+				// The tiered cache erases "key" here before it gives the key new
+				// data, so a key we still hold has not changed.
+				if ( index_.count( key.to_string() ) != 0 ) {
+					return;// Already holds the same data
+				}
+				if ( active_.size() + size > file_size_ ) {
+					seal();
+				}
+				location& loc = index_[ key.to_string() ];
+				loc.number    = active_number_;
+				loc.offset    = active_.size();
+				loc.size      = static_cast< uint32_t >( size );
+				active_.append( record );
+				active_keys_.emplace_back( key.data(), key.size() );
+			}
+
+			bool look_up( const slice& key, core::string* data ) override {
+				location                               loc;
+				core::string                           scratch;
+				core::shared_ptr< const core::string > buffer;
+				core::shared_ptr< random_access_file > file;
+				{
+					MutexLock l( &mutex_ );
+					auto      x = index_.find( key.to_string() );
+					if ( x == index_.end() ) {
+						return false;
+					}
+					loc = x->second;
+					if ( loc.number == active_number_ ) {
+						scratch.assign( active_, loc.offset, loc.size );
+					} else {
+						const sealed_file& f = sealed_.at( loc.number );
+						buffer               = f.buffer;
+						file                 = f.file;
+					}
+				}
+
+				slice record;
+				if ( buffer != nullptr ) {
+					record = slice( buffer->data() + loc.offset, loc.size );
+				} else if ( file != nullptr ) {
+					scratch.resize( loc.size );
+					if ( !file->read( loc.offset, loc.size, &record, &scratch[ 0 ] ).is_ok() ) {
+						record = slice();
+					}
+				} else {
+					record = scratch;
+				}
+
+				if ( !parse_record( key, record, data ) ) {
+					erase_if_at( key, loc );
+					return false;
+				}
+				return true;
+			}
+
+			void promoted( const slice& ) override {}
+
+			void erase( const slice& key ) override {
+				MutexLock l( &mutex_ );
+				index_.erase( key.to_string() );
+			}
+
+			void prune() override {
+				MutexLock l( &mutex_ );
+				while ( !sealed_.empty() ) {
+					drop( sealed_.begin() );
+				}
+				index_.clear();
+				active_.clear();
+				active_keys_.clear();
+			}
+
+			size_t total_charge() const override {
+				MutexLock l( &mutex_ );
+				size_t    total = active_.size();
+				for ( const auto& [ number, f ]: sealed_ ) {
+					if ( f.buffer != nullptr ) {
+						total += f.buffer->size();
+					}
+				}
+				return total;
+			}
+		};
+
+	}// end anonymous namespace
+
+	status new_file_tier( env* env, const core::string& dir, size_t capacity, size_t file_size,
+												secondary_tier** result ) {
+		*result = nullptr;
+		env->create_dir( dir );// Ignore error; the directory may exist already
+
+		core::vector< core::string > children;
+		status                       s = env->get_children( dir, &children );
+		if ( !s.is_ok() ) {
+			return s;
+		}
+		for ( const core::string& name: children ) {
+			if ( is_cache_file_name( name ) ) {
+				env->remove_file( dir + "/" + name );
+			}
+		}
+
+		*result = new file_tier( env, dir, capacity, file_size );
+		return status::ok();
+	}
+
+}// namespace simple_leveldb
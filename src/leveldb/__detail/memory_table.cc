@@ -1,16 +1,101 @@
 #include "leveldb/__detail/db_format.h"
 #include "leveldb/__detail/memory_table.h"
+#include "util/coding.h"
 #include <cassert>
+#include <cstring>
 
 namespace simple_leveldb {
 
-	mem_table::mem_table( const internal_key_comparator& comparator )
+	static slice get_length_prefixed_slice( const char* data ) {
+		uint32_t    len;
+		const char* p = data;
+		p             = get_varint32ptr( p, p + 5, &len );// +5: we assume "p" is not corrupted
+		return slice( p, len );
+	}
+
+	// Encode a suitable internal key target for "target" and return it.
+	// Uses *scratch as scratch space, and the returned pointer will point
+	// into this scratch space.
+	static const char* encode_key( core::string* scratch, const slice& target ) {
+		scratch->clear();
+		put_varint32( scratch, static_cast< uint32_t >( target.size() ) );
+		scratch->append( target.data(), target.size() );
+		return scratch->data();
+	}
+
+	int32_t mem_table::key_comparator::operator()( const char* aptr, const char* bptr ) const {
+		// Internal keys are encoded as length-prefixed strings.
+		slice a = get_length_prefixed_slice( aptr );
+		slice b = get_length_prefixed_slice( bptr );
+		return comparator.compare( a, b );
+	}
+
+	mem_table::mem_table( const internal_key_comparator& comparator, cache* block_cache )
 			: comparator_( comparator )
 			, refs_( 0 )
-			, table_( comparator_, &arena_ ) {}
+			, table_( comparator_, &arena_ )
+			, reservation_( block_cache ) {
+		reservation_.update( arena_.memory_usage() );
+	}
 
 	mem_table::~mem_table() {
 		assert( refs_ == 0 );
 	}
 
+	class mem_table_iterator : public iterator {
+	private:
+		mem_table::table::iterator iter_;
+		core::string               tmp_;// For passing to encode_key
+
+	public:
+		explicit mem_table_iterator( mem_table::table* table )
+				: iter_( table ) {}
+
+		mem_table_iterator( const mem_table_iterator& )            = delete;
+		mem_table_iterator& operator=( const mem_table_iterator& ) = delete;
+
+		~mem_table_iterator() override = default;
+
+		bool  valid() const override { return iter_.valid(); }
+		void  seek( const slice& k ) override { iter_.seek( encode_key( &tmp_, k ) ); }
+		void  seek_to_first() override { iter_.seek_to_first(); }
+		void  seek_to_last() override { iter_.seek_to_last(); }
+		void  next() override { iter_.next(); }
+		void  prev() override { iter_.prev(); }
+		slice key() const override { return get_length_prefixed_slice( iter_.key() ); }
+		slice value() const override {
+			slice key_slice = get_length_prefixed_slice( iter_.key() );
+			return get_length_prefixed_slice( key_slice.data() + key_slice.size() );
+		}
+
+		status get_status() const override { return status::ok(); }
+	};
+
+	iterator* mem_table::new_iterator() { return new mem_table_iterator( &table_ ); }
+
+	void mem_table::add( sequence_number s, value_type type, const slice& key, const slice& value ) {
+		// Format of an entry is concatenation of:
+		//  key_size     : varint32 of internal_key.size()
+		//  key bytes    : char[internal_key.size()]
+		//  tag          : uint64((sequence << 8) | type)
+		//  value_size   : varint32 of value.size()
+		//  value bytes  : char[value.size()]
+		const size_t key_size          = key.size();
+		const size_t val_size          = value.size();
+		const size_t internal_key_size = key_size + 8;
+		const size_t encoded_len       = varint_length( internal_key_size ) + internal_key_size +
+																		 varint_length( val_size ) + val_size;
+		char* buf = arena_.allocate( encoded_len );
+		char* p   = encode_varint32( buf, internal_key_size );
+		std::memcpy( p, key.data(), key_size );
+		p += key_size;
+		encode_fixed64( p, ( s << 8 ) | static_cast< uint64_t >( type ) );
+		p += 8;
+		p = encode_varint32( p, val_size );
+		std::memcpy( p, value.data(), val_size );
+		assert( p + val_size == buf + encoded_len );
+		table_.insert( buf );
+		reservation_.update( arena_.memory_usage() );
+	}
+
 }// namespace simple_leveldb
@@ -1,16 +1,21 @@
+#include "dirent.h"
 #include "fcntl.h"
 #include "leveldb/env.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "port/port_stdcxx.h"
+#include "port/thread_annotations.h"
 #include "sys/mman.h"
 #include "sys/stat.h"
+#include "sys/time.h"
 #include "sys/types.h"
 #include "unistd.h"
+#include "util/mutex_lock.h"
 #include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -24,6 +29,7 @@
 #include <string>
 #include <sys/mman.h>
 #include <sys/resource.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -40,6 +46,17 @@ namespace simple_leveldb {
 
 	constexpr const size_t kWritableFileBufferSize = 65536;
 
+	// Offsets, sizes and buffers of O_DIRECT I/O must be multiples of the
+	// logical block size; 4K covers every device we care about.
+	constexpr const size_t kDirectIOAlignment = 4096;
+
+	static_assert( kWritableFileBufferSize % kDirectIOAlignment == 0,
+								 "direct writes flush whole buffers" );
+
+	static inline size_t round_up_to_alignment( size_t n ) {
+		return ( n + kDirectIOAlignment - 1 ) & ~( kDirectIOAlignment - 1 );
+	}
+
 	status posix_error( const core::string& context, int32_t error_number ) {
 		if ( error_number == ENOENT ) {
 			return status::not_found( context, core::strerror( error_number ) );
@@ -196,6 +213,231 @@ namespace simple_leveldb {
 			*result = slice( mmap_base_ + offset, n );
 			return status::ok();
 		}
+
+		bool reads_in_place() const override { return true; }
+
+		status will_need( uint64_t offset, size_t n ) override {
+			if ( offset >= length_ ) {
+				return status::ok();
+			}
+			n = core::min( n, static_cast< size_t >( length_ - offset ) );
+
+			// madvise() wants a page aligned start address.
+			static const uintptr_t page_size = static_cast< uintptr_t >( ::sysconf( _SC_PAGESIZE ) );
+			const uintptr_t        start     = reinterpret_cast< uintptr_t >( mmap_base_ + offset );
+			const uintptr_t        aligned   = start & ~( page_size - 1 );
+			if ( ::madvise( reinterpret_cast< void* >( aligned ), n + ( start - aligned ), MADV_WILLNEED ) != 0 ) {
+				return posix_error( filename_, errno );
+			}
+			return status::ok();
+		}
+	};
+
+	// Reads through O_DIRECT, so data never lands in the page cache.  Each
+	// read covers the aligned extent around the request and copies the part
+	// that was asked for into "scratch".  Like posix_random_access_file, it
+	// only keeps its fd open if fd_limiter allows, and otherwise reopens the
+	// file with the same flags for every read.
+	class posix_direct_random_access_file final : public random_access_file {
+	private:
+		const bool         has_permanent_fd_;
+		const int32_t      fd_;
+		const int32_t      flags_;
+		limiter* const     fd_limiter_;
+		const core::string filename_;
+
+	public:
+		posix_direct_random_access_file( core::string filename, int32_t fd, int32_t flags, limiter* fd_limiter )
+				: has_permanent_fd_( fd_limiter->acquire() )
+				, fd_( has_permanent_fd_ ? fd : -1 )
+				, flags_( flags )
+				, fd_limiter_( fd_limiter )
+				, filename_( filename ) {
+			if ( !has_permanent_fd_ ) {
+				assert( fd_ == -1 );
+				::close( fd );
+			}
+		}
+		~posix_direct_random_access_file() override {
+			if ( has_permanent_fd_ ) {
+				assert( fd_ != -1 );
+				::close( fd_ );
+				fd_limiter_->release();
+			}
+		}
+
+	public:
+		status read( uint64_t offset, size_t n, slice* result, char* scratch ) const override {
+			const uint64_t aligned_offset = offset & ~static_cast< uint64_t >( kDirectIOAlignment - 1 );
+			const size_t   skip           = static_cast< size_t >( offset - aligned_offset );
+			const size_t   aligned_size   = round_up_to_alignment( skip + n );
+			char*          buf = static_cast< char* >( core::aligned_alloc( kDirectIOAlignment, aligned_size ) );
+			if ( buf == nullptr ) {
+				*result = slice();
+				return posix_error( filename_, ENOMEM );
+			}
+
+			int32_t fd = fd_;
+			if ( !has_permanent_fd_ ) {
+				fd = ::open( filename_.c_str(), flags_ );
+				if ( fd < 0 ) {
+					const int32_t error_number = errno;
+					core::free( buf );
+					*result = slice();
+					return posix_error( filename_, error_number );
+				}
+			}
+			assert( fd != -1 );
+
+			status stat;
+			size_t bytes_read = 0;
+			while ( bytes_read < aligned_size ) {
+				::ssize_t read_size = ::pread( fd, buf + bytes_read, aligned_size - bytes_read,
+																			 static_cast< off_t >( aligned_offset + bytes_read ) );
+				if ( read_size < 0 ) {
+					if ( errno == EINTR ) {
+						continue;
+					}
+					stat = posix_error( filename_, errno );
+					break;
+				}
+				if ( read_size == 0 ) {
+					break;// EOF
+				}
+				bytes_read += read_size;
+			}
+			if ( !has_permanent_fd_ ) {
+				assert( fd != fd_ );
+				::close( fd );
+			}
+
+			const size_t available = ( bytes_read > skip ) ? core::min( n, bytes_read - skip ) : 0;
+			if ( stat.is_ok() ) {
+				::memcpy( scratch, buf + skip, available );
+				*result = slice( scratch, available );
+			} else {
+				*result = slice();
+			}
+			core::free( buf );
+			return stat;
+		}
+	};
+
+	// Writes through O_DIRECT from an aligned kWritableFileBufferSize buffer.
+	// Only whole buffers are written as data arrives.  flush() cannot write
+	// a partial block, so it is a no-op.  sync() and close() write the tail
+	// padded to the alignment and trim the file back to its real size.
+	class posix_direct_writable_file final : public writable_file {
+	private:
+		char*              buf_;
+		size_t             pos_;
+		uint64_t           file_offset_;// Offset in the file of buf_[0]; always aligned
+		int32_t            fd_;
+		const core::string filename_;
+
+	public:
+		posix_direct_writable_file( core::string filename, int32_t fd, char* buf )
+				: buf_( buf )
+				, pos_( 0 )
+				, file_offset_( 0 )
+				, fd_( fd )
+				, filename_( filename ) {}
+
+		~posix_direct_writable_file() override {
+			if ( fd_ >= 0 ) {
+				close();
+			}
+			core::free( buf_ );
+		}
+
+	public:
+		status append( const slice& data ) override {
+			const char* write_data = data.data();
+			size_t      write_size = data.size();
+			while ( write_size > 0 ) {
+				size_t copy_size = core::min( write_size, kWritableFileBufferSize - pos_ );
+				::memcpy( buf_ + pos_, write_data, copy_size );
+				write_data += copy_size;
+				write_size -= copy_size;
+				pos_ += copy_size;
+
+				if ( pos_ == kWritableFileBufferSize ) {
+					status stat = write_aligned( kWritableFileBufferSize );
+					if ( !stat.is_ok() ) {
+						return stat;
+					}
+					file_offset_ += kWritableFileBufferSize;
+					pos_ = 0;
+				}
+			}
+			return status::ok();
+		}
+
+		status close() override {
+			status        stat         = write_tail();
+			const int32_t close_result = ::close( fd_ );
+			if ( close_result < 0 && stat.is_ok() ) {
+				stat = posix_error( filename_, errno );
+			}
+			fd_ = -1;
+			return stat;
+		}
+
+		status flush() override { return status::ok(); }
+
+		status sync() override {
+			status stat = write_tail();
+			if ( !stat.is_ok() ) {
+				return stat;
+			}
+			if ( ::fdatasync( fd_ ) != 0 ) {
+				return posix_error( filename_, errno );
+			}
+			return status::ok();
+		}
+
+	private:
+		// Write buf_[0, size) at file_offset_.  REQUIRES: size is aligned.
+		status write_aligned( size_t size ) {
+			assert( size % kDirectIOAlignment == 0 );
+			size_t written = 0;
+			while ( written < size ) {
+				::ssize_t write_result = ::pwrite( fd_, buf_ + written, size - written,
+																					 static_cast< off_t >( file_offset_ + written ) );
+				if ( write_result < 0 ) {
+					if ( errno == EINTR ) {
+						continue;
+					}
+					return posix_error( filename_, errno );
+				}
+				written += write_result;
+			}
+			return status::ok();
+		}
+
+		// Write the buffered bytes, zero padded to the alignment, then cut the
+		// padding off the file.  Whole blocks leave the buffer; the partial
+		// last block stays so later appends rewrite it in place.
+		status write_tail() {
+			if ( pos_ == 0 ) {
+				return status::ok();
+			}
+			const size_t padded = round_up_to_alignment( pos_ );
+			::memset( buf_ + pos_, 0, padded - pos_ );
+			status stat = write_aligned( padded );
+			if ( !stat.is_ok() ) {
+				return stat;
+			}
+			if ( ::ftruncate( fd_, static_cast< off_t >( file_offset_ + pos_ ) ) != 0 ) {
+				return posix_error( filename_, errno );
+			}
+
+			const size_t whole_blocks = pos_ & ~( kDirectIOAlignment - 1 );
+			::memmove( buf_, buf_ + whole_blocks, pos_ - whole_blocks );
+			file_offset_ += whole_blocks;
+			pos_ -= whole_blocks;
+			return status::ok();
+		}
 	};
 
 	class posix_writable_file final : public writable_file {
@@ -394,31 +636,102 @@ namespace simple_leveldb {
 		return g_open_read_only_file_limit;
 	}
 
-	class posix_env : public env {
+	// Threads that run scheduled jobs in FIFO order.  Threads are started
+	// when there is work for them and only exit when the pool shrinks; a
+	// pool lives as long as the env singleton that owns it.
+	class thread_pool {
 	private:
 		struct background_work_item {
 			explicit background_work_item( core::function< void( void* ) >&& f, void* a )
 					: func( core::move( f ) )
 					, arg( a ) {}
 
-			const core::function< void( void* ) > func;
-			void* const                           arg;
+			core::function< void( void* ) > func;
+			void*                           arg;
 		};
 
-		port::mutex    background_work_mutex_;
-		port::cond_var background_work_cv_;
-		bool           started_background_thread_;
+		port::mutex    mutex_;
+		port::cond_var work_cv_;
 
-		core::queue< background_work_item > background_work_queue_;
-		posix_lock_table                    locks_;
-		limiter                             mmap_limiter_;
-		limiter                             fd_limiter_;
+		int32_t                             target_threads_ GUARDED_BY( mutex_ );
+		int32_t                             running_threads_ GUARDED_BY( mutex_ );
+		core::queue< background_work_item > queue_ GUARDED_BY( mutex_ );
+
+		// REQUIRES: mutex_ held
+		void start_threads() {
+			while ( running_threads_ < target_threads_ ) {
+				core::thread new_thread( &thread_pool::thread_main, this );
+				new_thread.detach();
+				running_threads_++;
+			}
+		}
+
+		void thread_main() {
+			mutex_.lock();
+			while ( true ) {
+				while ( queue_.empty() && running_threads_ <= target_threads_ ) {
+					work_cv_.wait();
+				}
+				if ( running_threads_ > target_threads_ ) {
+					// The pool shrank; one thread too many.
+					running_threads_--;
+					break;
+				}
+				background_work_item item = core::move( queue_.front() );
+				queue_.pop();
+
+				mutex_.unlock();
+				item.func( item.arg );
+				mutex_.lock();
+			}
+			mutex_.unlock();
+		}
+
+	public:
+		thread_pool()
+				: work_cv_( &mutex_ )
+				, target_threads_( 1 )
+				, running_threads_( 0 ) {}
+
+		thread_pool( const thread_pool& )            = delete;
+		thread_pool& operator=( const thread_pool& ) = delete;
+
+	public:
+		void schedule( core::function< void( void* ) >&& func, void* args ) {
+			MutexLock l( &mutex_ );
+			start_threads();
+			queue_.emplace( core::move( func ), args );
+			work_cv_.signal();
+		}
+
+		// At least one thread is kept, so scheduled jobs always run.
+		void set_threads( int32_t number ) {
+			MutexLock l( &mutex_ );
+			target_threads_ = core::max( number, 1 );
+			if ( !queue_.empty() ) {
+				start_threads();
+			}
+			work_cv_.signal_all();
+		}
+
+		int32_t threads() {
+			MutexLock l( &mutex_ );
+			return target_threads_;
+		}
+	};
+
+	class posix_env : public env {
+	private:
+		thread_pool      thread_pools_[ 2 ];// Indexed by priority
+		posix_lock_table locks_;
+		limiter          mmap_limiter_;
+		limiter          fd_limiter_;
+
+		thread_pool* pool( priority pri ) { return &thread_pools_[ static_cast< int >( pri ) ]; }
 
 	public:
 		posix_env()
-				: background_work_cv_( &background_work_mutex_ )
-				, started_background_thread_( false )
-				, mmap_limiter_( max_mmaps() )
+				: mmap_limiter_( max_mmaps() )
 				, fd_limiter_( max_open_files() ) {}
 
 		~posix_env() override {
@@ -469,23 +782,136 @@ namespace simple_leveldb {
 			return stat;
 		}
 
-		status   new_writable_file( const core::string& filename, writable_file** result ) override {}
+		status new_direct_random_access_file( const core::string& filename, random_access_file** result ) override {
+			*result = nullptr;
+#if defined( O_DIRECT )
+			const int32_t flags = O_RDONLY | O_DIRECT | kOpenBaseFlags;
+			int32_t       fd    = ::open( filename.c_str(), flags );
+			if ( fd < 0 ) {
+				return direct_open_error( filename, errno );
+			}
+			*result = new posix_direct_random_access_file( filename, fd, flags, &fd_limiter_ );
+			return status::ok();
+#else
+			return status::not_supported( "direct I/O", filename );
+#endif
+		}
+
+		status new_direct_writable_file( const core::string& filename, writable_file** result ) override {
+			*result = nullptr;
+#if defined( O_DIRECT )
+			int32_t fd = ::open( filename.c_str(), O_TRUNC | O_WRONLY | O_CREAT | O_DIRECT | kOpenBaseFlags, 0644 );
+			if ( fd < 0 ) {
+				return direct_open_error( filename, errno );
+			}
+			char* buf = static_cast< char* >( core::aligned_alloc( kDirectIOAlignment, kWritableFileBufferSize ) );
+			if ( buf == nullptr ) {
+				::close( fd );
+				return posix_error( filename, ENOMEM );
+			}
+			*result = new posix_direct_writable_file( filename, fd, buf );
+			return status::ok();
+#else
+			return status::not_supported( "direct I/O", filename );
+#endif
+		}
+
+		status new_writable_file( const core::string& filename, writable_file** result ) override {
+			int32_t fd = ::open( filename.c_str(), O_TRUNC | O_WRONLY | O_CREAT | kOpenBaseFlags, 0644 );
+			if ( fd < 0 ) {
+				*result = nullptr;
+				return posix_error( filename, errno );
+			}
+
+			*result = new posix_writable_file( filename, fd );
+			return status::ok();
+		}
+
+		bool file_exists( const core::string& filename ) override {
+			return ::access( filename.c_str(), F_OK ) == 0;
+		}
+
+		status get_children( const core::string& directory_path, core::vector< core::string >* result ) override {
+			result->clear();
+			::DIR* dir = ::opendir( directory_path.c_str() );
+			if ( dir == nullptr ) {
+				return posix_error( directory_path, errno );
+			}
+			struct ::dirent* entry;
+			while ( ( entry = ::readdir( dir ) ) != nullptr ) {
+				result->emplace_back( entry->d_name );
+			}
+			::closedir( dir );
+			return status::ok();
+		}
+
+		status remove_file( const core::string& filename ) override {
+			if ( ::unlink( filename.c_str() ) != 0 ) {
+				return posix_error( filename, errno );
+			}
+			return status::ok();
+		}
+
+		status create_dir( const core::string& dirname ) override {
+			if ( ::mkdir( dirname.c_str(), 0755 ) != 0 ) {
+				return posix_error( dirname, errno );
+			}
+			return status::ok();
+		}
+
+		status get_file_size( const core::string& filename, uint64_t* size ) override {
+			struct ::stat file_stat;
+			if ( ::stat( filename.c_str(), &file_stat ) != 0 ) {
+				*size = 0;
+				return posix_error( filename, errno );
+			}
+			*size = file_stat.st_size;
+			return status::ok();
+		}
+
+		void schedule( core::function< void( void* ) >&& func, void* args,
+									 priority pri = priority::kLow ) override {
+			pool( pri )->schedule( core::move( func ), args );
+		}
+
+		void set_background_threads( int32_t number, priority pri ) override {
+			pool( pri )->set_threads( number );
+		}
+
+		int32_t get_background_threads( priority pri ) override { return pool( pri )->threads(); }
+
+		void start_thread( core::function< void( void* ) >&& func, void* args ) override {
+			core::thread new_thread( core::move( func ), args );
+			new_thread.detach();
+		}
+
 		status   new_appendable_file( const core::string& filename, writable_file** result ) override {}
-		bool     file_exists( const core::string& filename ) override {}
-		status   get_children( const core::string& directory_path, core::vector< core::string >* result ) override {}
-		status   remove_file( const core::string& filename ) override {}
-		status   create_dir( const core::string& dirname ) override {}
 		status   remove_dir( const core::string& dirname ) override {}
-		status   get_file_size( const core::string& filename, uint64_t* size ) override {}
 		status   rename_file( const core::string& from, const core::string& to ) override {}
 		status   lock_file( const core::string& filename, file_lock** lock ) override {}
 		status   unlock_file( file_lock* lock ) override {}
-		void     schedule( core::function< void( void* ) >&& func, void* args ) override {}
-		void     start_thread( core::function< void( void* ) >&& func, void* args ) override {}
 		status   get_test_directory( core::string* path ) override {}
 		status   new_logger( const core::string& fname, logger** result ) override {}
-		uint64_t now_micros() override {}
-		void     sleep_for_microseconds( int32_t micros ) override {}
+		uint64_t now_micros() override {
+			static constexpr uint64_t kUsecondsPerSecond = 1000000;
+			struct ::timeval          tv;
+			::gettimeofday( &tv, nullptr );
+			return static_cast< uint64_t >( tv.tv_sec ) * kUsecondsPerSecond + tv.tv_usec;
+		}
+
+		void sleep_for_microseconds( int32_t micros ) override {
+			core::this_thread::sleep_for( core::chrono::microseconds( micros ) );
+		}
+
+	private:
+		// File systems without O_DIRECT support (e.g. tmpfs) reject the flag
+		// with EINVAL; report that as not_supported so callers fall back.
+		static status direct_open_error( const core::string& filename, int32_t error_number ) {
+			if ( error_number == EINVAL ) {
+				return status::not_supported( "direct I/O", filename );
+			}
+			return posix_error( filename, error_number );
+		}
 	};
 
 	namespace {
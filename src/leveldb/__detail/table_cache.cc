@@ -1,19 +1,267 @@
 #include "leveldb/__detail/table_cache.h"
+#include "leveldb/__detail/db_format.h"
+#include "leveldb/__detail/filename.h"
 #include "leveldb/cache.h"
+#include "leveldb/env.h"
+#include "leveldb/iterator.h"
 #include "leveldb/slice.h"
+#include "leveldb/table.h"
 #include "util/coding.h"
+#include "util/mutex_lock.h"
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <limits>
+#include <string>
 
 namespace simple_leveldb {
 
+	struct table_and_file {
+		random_access_file* file;
+		table*              tbl;
+	};
+
+	static void delete_entry( const slice&, void* value ) {
+		table_and_file* tf = reinterpret_cast< table_and_file* >( value );
+		delete tf->tbl;
+		delete tf->file;
+		delete tf;
+	}
+
+	static size_t capacity_for( int32_t entries ) {
+		// Every entry has a charge of 1.
+		return entries < 0 ? core::numeric_limits< int32_t >::max() : entries;
+	}
+
+	// Row cache entries
+	//
+	// The key is our row_cache_id_ (fixed64), the file number (varint64) and
+	// the user key.  The value is empty if the file has no entry for the user
+	// key, or else holds its newest entry:
+	//
+	//    internal key (length prefixed) | value
+	//
+	// The newest entry answers every lookup at a sequence number at or above
+	// its own; older snapshots read the table.
+	static void delete_row( const slice&, void* value ) {
+		delete reinterpret_cast< core::string* >( value );
+	}
+
 	table_cache::table_cache( const core::string& dbname, const options& options, int32_t entries )
 			: env_( options.env )
 			, dbname_( dbname )
 			, options_( options )
-			, cache_( new_lru_cache( entries ) ) {}
+			, cache_( new_lru_cache( capacity_for( entries ) ) )
+			, row_cache_id_( options.row_cache != nullptr ? options.row_cache->new_id() : 0 )
+			, opened_cv_( &mutex_ ) {}
 
 	table_cache::~table_cache() { delete cache_; }
 
+	status table_cache::find_table( uint64_t file_number, uint64_t file_size, cache::handle** handle ) {
+		char buf[ sizeof( file_number ) ];
+		encode_fixed64( buf, file_number );
+		const slice key( buf, sizeof( buf ) );
+		*handle = cache_->look_up( key );
+		if ( *handle != nullptr ) {
+			return status::ok();
+		}
+
+		{
+			MutexLock l( &mutex_ );
+			while ( opening_.count( file_number ) != 0 ) {
+				opened_cv_.wait();
+			}
+			// Whoever we waited for may have opened it; if their open failed we
+			// try again ourselves.
+			*handle = cache_->look_up( key );
+			if ( *handle != nullptr ) {
+				return status::ok();
+			}
+			opening_.insert( file_number );
+		}
+
+		status s = open_table( file_number, file_size, handle );
+
+		MutexLock l( &mutex_ );
+		opening_.erase( file_number );
+		opened_cv_.signal_all();
+		return s;
+	}
+
+	// Open the table and insert it into cache_.  Errors are not cached, so
+	// a transient error or a repaired file is retried by the next caller.
+	status table_cache::open_table( uint64_t file_number, uint64_t file_size, cache::handle** handle ) {
+		random_access_file* file = nullptr;
+		table*              t    = nullptr;
+		status              s    = open_random_access_file( env_, table_file_name( dbname_, file_number ),
+																											options_.use_direct_reads, &file );
+		if ( s.is_ok() ) {
+			s = table::open( options_, file, file_size, &t );
+		}
+		if ( !s.is_ok() ) {
+			assert( t == nullptr );
+			delete file;
+			return s;
+		}
+
+		table_and_file* tf = new table_and_file;
+		tf->file           = file;
+		tf->tbl            = t;
+		char buf[ sizeof( file_number ) ];
+		encode_fixed64( buf, file_number );
+		*handle = cache_->insert( slice( buf, sizeof( buf ) ), tf, 1, &delete_entry );
+		return s;
+	}
+
+	void table_cache::release( cache::handle* handle ) { cache_->release( handle ); }
+
+	iterator* table_cache::new_iterator( const read_options& options, uint64_t file_number,
+																			 uint64_t file_size ) {
+		cache::handle* handle = nullptr;
+		status         s      = find_table( file_number, file_size, &handle );
+		if ( !s.is_ok() ) {
+			return new_error_iterator( s );
+		}
+
+		table*    t      = reinterpret_cast< table_and_file* >( cache_->value( handle ) )->tbl;
+		iterator* result = t->new_iterator( options );
+		result->register_cleanup( [ this, handle ] { release( handle ); } );
+		return result;
+	}
+
+	status table_cache::get( const read_options& options, uint64_t file_number, uint64_t file_size,
+													 const slice& k,
+													 const core::function< void( const slice&, const slice& ) >& handle_result ) {
+		cache* const row_cache = options_.row_cache;
+		if ( row_cache == nullptr ) {
+			return get_from_table( options, file_number, file_size, k, handle_result );
+		}
+
+		const slice  user_key = extract_user_key( k );
+		core::string row_key;
+		put_fixed64( &row_key, row_cache_id_ );
+		put_varint64( &row_key, file_number );
+		row_key.append( user_key.data(), user_key.size() );
+
+		const uint64_t seq = decode_fixed64( k.data() + k.size() - 8 ) >> 8;
+		core::string*  row = nullptr;
+		cache::handle* h   = row_cache->look_up( row_key );
+		if ( h == nullptr ) {
+			// Fetch the newest entry for the user key, whatever "k" asks for.
+			const comparator* ucmp = static_cast< const internal_key_comparator* >( options_.comparator )
+																 ->user_comparator();
+			const internal_key newest( user_key, kMaxSequenceNumber, kValueTypeForSeek );
+			core::string       found;
+			status             s = get_from_table(
+				options, file_number, file_size, newest.encode(),
+				[ & ]( const slice& found_key, const slice& found_value ) {
+					if ( ucmp->compare( extract_user_key( found_key ), user_key ) == 0 ) {
+						put_length_prefixed_slice( &found, found_key );
+						found.append( found_value.data(), found_value.size() );
+					}
+				} );
+			if ( !s.is_ok() ) {
+				return s;
+			}
+			row = new core::string( core::move( found ) );
+			if ( options.fill_cache ) {
+				h = row_cache->insert( row_key, row, row_key.size() + row->size(), &delete_row );
+			}
+		} else {
+			row = reinterpret_cast< core::string* >( row_cache->value( h ) );
+		}
+
+		status s;
+		slice  input = *row;
+		slice  found_key;
+		if ( input.empty() ) {
+			// The file has no entry for the user key.
+		} else if ( get_length_prefixed_slice( &input, &found_key ) &&
+								decode_fixed64( found_key.data() + found_key.size() - 8 ) >> 8 <= seq ) {
+			handle_result( found_key, input );
+		} else {
+			s = get_from_table( options, file_number, file_size, k, handle_result );
+		}
+
+		if ( h != nullptr ) {
+			row_cache->release( h );
+		} else {
+			delete row;
+		}
+		return s;
+	}
+
+	status table_cache::get_from_table( const read_options& options, uint64_t file_number,
+																			uint64_t file_size, const slice& k,
+																			const core::function< void( const slice&, const slice& ) >& handle_result ) {
+		cache::handle* handle = nullptr;
+		status         s      = find_table( file_number, file_size, &handle );
+		if ( s.is_ok() ) {
+			table* t = reinterpret_cast< table_and_file* >( cache_->value( handle ) )->tbl;
+			s        = t->internal_get( options, k, handle_result );
+			cache_->release( handle );
+		}
+		return s;
+	}
+
+	status table_cache::preload( const core::vector< file_meta_data* >& files, int32_t threads ) {
+		struct state {
+			table_cache*                            cache;
+			const core::vector< file_meta_data* >* files;
+			port::mutex                             mutex;
+			port::cond_var                          done_cv;
+			size_t                                  next GUARDED_BY( mutex );
+			int32_t                                 running GUARDED_BY( mutex );
+			status                                  first_error GUARDED_BY( mutex );
+
+			state()
+					: done_cv( &mutex ) {}
+		};
+
+		state st;
+		st.cache   = this;
+		st.files   = &files;
+		st.next    = 0;
+		st.running = core::max< int32_t >( 1, core::min< int32_t >( threads, files.size() ) );
+
+		auto worker = []( void* arg ) {
+			state* st = reinterpret_cast< state* >( arg );
+			st->mutex.lock();
+			while ( st->next < st->files->size() && st->first_error.is_ok() ) {
+				const file_meta_data* f = ( *st->files )[ st->next++ ];
+				st->mutex.unlock();
+
+				cache::handle* handle = nullptr;
+				status         s      = st->cache->find_table( f->number, f->file_size, &handle );
+				if ( s.is_ok() ) {
+					// Only warm it; an unbounded cache keeps it open anyway.
+					st->cache->release( handle );
+				}
+
+				st->mutex.lock();
+				if ( !s.is_ok() && st->first_error.is_ok() ) {
+					st->first_error = s;
+				}
+			}
+			if ( --st->running == 0 ) {
+				st->done_cv.signal_all();
+			}
+			st->mutex.unlock();
+		};
+
+		// The calling thread works too.
+		for ( int32_t i = 1; i < st.running; i++ ) {
+			env_->start_thread( worker, &st );
+		}
+		worker( &st );
+
+		MutexLock l( &st.mutex );
+		while ( st.running > 0 ) {
+			st.done_cv.wait();
+		}
+		return st.first_error;
+	}
+
 	void table_cache::evict( uint64_t file_number ) {
 		char buf[ sizeof file_number ];
 		encode_fixed64( buf, file_number );
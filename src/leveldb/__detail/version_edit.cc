@@ -18,9 +18,50 @@ namespace simple_leveldb {
 		kDeletedFile    = 6,
 		kNewFile        = 7,
 		// 8 was used for large value refs
-		kPrevLogNumber = 9
+		kPrevLogNumber         = 9,
+		kNewFileWithProperties = 10
 	};
 
+	// Fields of table_properties in manifest order.  Append only: older
+	// records simply lack the trailing fields, which then stay zero.
+	static uint64_t table_properties::* const kPropertyFields[] = {
+		&table_properties::num_entries,
+		&table_properties::num_deletions,
+		&table_properties::raw_key_size,
+		&table_properties::raw_value_size,
+		&table_properties::data_size,
+		&table_properties::index_size,
+		&table_properties::filter_size,
+		&table_properties::smallest_seqno,
+		&table_properties::largest_seqno,
+		&table_properties::creation_time,
+	};
+
+	static void put_table_properties( core::string* dst, const table_properties& props ) {
+		core::string encoded;
+		for ( auto field: kPropertyFields ) {
+			put_varint64( &encoded, props.*field );
+		}
+		put_length_prefixed_slice( dst, encoded );
+	}
+
+	static bool get_table_properties( slice* input, table_properties* props ) {
+		slice encoded;
+		if ( !get_length_prefixed_slice( input, &encoded ) ) {
+			return false;
+		}
+		*props = table_properties();
+		for ( auto field: kPropertyFields ) {
+			if ( encoded.empty() ) {
+				break;
+			}
+			if ( !get_varint64( &encoded, &( props->*field ) ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
 	void version_edit::clear() {
 		comparator_.clear();
 		log_number_           = 0;
@@ -95,13 +136,17 @@ namespace simple_leveldb {
 		}
 
 		for ( auto [ level, f ]: new_files_ ) {
-			const file_meta_data& file = f;
-			put_varint32( dst, kNewFile );
+			const file_meta_data& file           = f;
+			const bool            has_properties = ( file.properties.num_entries != 0 );
+			put_varint32( dst, has_properties ? kNewFileWithProperties : kNewFile );
 			put_varint32( dst, level );
 			put_varint64( dst, file.number );
 			put_varint64( dst, file.file_size );
 			put_length_prefixed_slice( dst, file.smallest.encode() );
 			put_length_prefixed_slice( dst, file.largest.encode() );
+			if ( has_properties ) {
+				put_table_properties( dst, file.properties );
+			}
 		}
 	}
 
@@ -182,6 +227,18 @@ namespace simple_leveldb {
 							 get_varint64( &input, &f.file_size ) &&
 							 get_internal_key( &input, &f.smallest ) &&
 							 get_internal_key( &input, &f.largest ) ) {
+						f.properties = table_properties();
+						new_files_.emplace_back( core::make_pair( level, f ) );
+					} else {
+						msg = "new-file entry";
+					}
+					break;
+				case kNewFileWithProperties:
+					if ( get_level( &input, &level ) && get_varint64( &input, &f.number ) &&
+							 get_varint64( &input, &f.file_size ) &&
+							 get_internal_key( &input, &f.smallest ) &&
+							 get_internal_key( &input, &f.largest ) &&
+							 get_table_properties( &input, &f.properties ) ) {
 						new_files_.emplace_back( core::make_pair( level, f ) );
 					} else {
 						msg = "new-file entry";
@@ -204,12 +261,14 @@ namespace simple_leveldb {
 	}
 
 	void version_edit::add_file( int32_t level, uint64_t file, uint64_t file_size,
-															 const internal_key& smallest, const internal_key& largest ) {
+															 const internal_key& smallest, const internal_key& largest,
+															 const table_properties& properties ) {
 		file_meta_data f;
-		f.number    = file;
-		f.file_size = file_size;
-		f.smallest  = smallest;
-		f.largest   = largest;
+		f.number     = file;
+		f.file_size  = file_size;
+		f.smallest   = smallest;
+		f.largest    = largest;
+		f.properties = properties;
 		new_files_.emplace_back( core::make_pair( level, f ) );
 	}
 
@@ -2,12 +2,18 @@
 #include "leveldb/__detail/filename.h"
 #include "leveldb/__detail/log_reader.h"
 #include "leveldb/__detail/log_write.h"
+#include "leveldb/__detail/table_cache.h"
 #include "leveldb/__detail/version_edit.h"
 #include "leveldb/__detail/version_set.h"
 #include "leveldb/env.h"
+#include "leveldb/iterator.h"
 #include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
+#include "table/merger.h"
+#include "table/two_level_iterator.h"
+#include "util/coding.h"
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -21,6 +27,24 @@ namespace simple_leveldb {
 		return option->max_file_size;
 	}
 
+	// Maximum bytes of overlaps in grandparent (i.e., level+2) before we
+	// stop building a single file in a level->level+1 compaction.
+	static int64_t max_grand_parent_overlap_bytes( const options* option ) {
+		return 10 * target_file_size( option );
+	}
+
+	// Maximum number of bytes in all compacted files.  We avoid expanding
+	// the lower level file set of a compaction if it would make the
+	// total compaction cover more than this many bytes.
+	static int64_t expanded_compaction_byte_size_limit( const options* option ) {
+		return 25 * target_file_size( option );
+	}
+
+	static uint64_t max_file_size_for_level( const options* option, int32_t level ) {
+		// We could vary per level to reduce number of files?
+		return target_file_size( option );
+	}
+
 	version::version( version_set* vset )
 			: vset_( vset )
 			, next_( nullptr )
@@ -28,8 +52,14 @@ namespace simple_leveldb {
 			, refs_( 0 )
 			, file_to_compact_( nullptr )
 			, file_to_compact_level_( -1 )
+			, rewrite_file_to_compact_( false )
 			, compaction_score_( -1 )
-			, compaction_level_( -1 ) {}
+			, compaction_level_( -1 )
+			, base_level_( 1 ) {
+		for ( int32_t level = 0; level < config::kNumLevels; level++ ) {
+			level_max_bytes_[ level ] = 0;
+		}
+	}
 
 	version::~version() {
 		assert( refs_ == 0 );
@@ -62,6 +92,46 @@ namespace simple_leveldb {
 		}
 	}
 
+	void version::get_overlapping_inputs( int32_t level, const internal_key* begin, const internal_key* end,
+																				core::vector< file_meta_data* >* inputs ) {
+		assert( level >= 0 );
+		assert( level < config::kNumLevels );
+		inputs->clear();
+		slice user_begin, user_end;
+		if ( begin != nullptr ) {
+			user_begin = begin->user_key();
+		}
+		if ( end != nullptr ) {
+			user_end = end->user_key();
+		}
+		const comparator* user_cmp = vset_->icmp_.user_comparator();
+		for ( size_t i = 0; i < files_[ level ].size(); ) {
+			file_meta_data* f          = files_[ level ][ i++ ];
+			const slice     file_start = f->smallest.user_key();
+			const slice     file_limit = f->largest.user_key();
+			if ( begin != nullptr && user_cmp->compare( file_limit, user_begin ) < 0 ) {
+				// "f" is completely before specified range; skip it
+			} else if ( end != nullptr && user_cmp->compare( file_start, user_end ) > 0 ) {
+				// "f" is completely after specified range; skip it
+			} else {
+				inputs->push_back( f );
+				if ( level == 0 ) {
+					// Level-0 files may overlap each other.  So check if the newly
+					// added file has expanded the range.  If so, restart search.
+					if ( begin != nullptr && user_cmp->compare( file_start, user_begin ) < 0 ) {
+						user_begin = file_start;
+						inputs->clear();
+						i = 0;
+					} else if ( end != nullptr && user_cmp->compare( file_limit, user_end ) > 0 ) {
+						user_end = file_limit;
+						inputs->clear();
+						i = 0;
+					}
+				}
+			}
+		}
+	}
+
 }// namespace simple_leveldb
 
 namespace simple_leveldb {
@@ -81,14 +151,18 @@ namespace simple_leveldb {
 			, descriptor_file_( nullptr )
 			, descriptor_log_( nullptr )
 			, dummy_versions_( this )
-			, current_( nullptr ) {
+			, current_( nullptr )
+			, manifest_writing_( false ) {
 		append_version( new version( this ) );
 	}
 
-	static double max_bytes_for_level( const options* options, int32_t level ) {
-		double result = 10. * 1048576.0;
+	static const double kMaxBytesForLevelBase = 10. * 1048576.0;
+	static const double kLevelSizeMultiplier  = 10;
+
+	static double max_bytes_for_level( int32_t level ) {
+		double result = kMaxBytesForLevelBase;
 		while ( level-- > 1 ) {
-			result *= 10;
+			result *= kLevelSizeMultiplier;
 		}
 		return result;
 	}
@@ -101,6 +175,87 @@ namespace simple_leveldb {
 		return sum;
 	}
 
+	static bool any_being_compacted( const core::vector< file_meta_data* >& files ) {
+		for ( const auto file: files ) {
+			if ( file->being_compacted ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Finds the largest key in a vector of files.  Returns true if files is not
+	// empty.
+	static bool find_largest_key( const internal_key_comparator& icmp,
+																const core::vector< file_meta_data* >& files, internal_key* largest_key ) {
+		if ( files.empty() ) {
+			return false;
+		}
+		*largest_key = files[ 0 ]->largest;
+		for ( size_t i = 1; i < files.size(); ++i ) {
+			file_meta_data* f = files[ i ];
+			if ( icmp.compare( f->largest, *largest_key ) > 0 ) {
+				*largest_key = f->largest;
+			}
+		}
+		return true;
+	}
+
+	// Finds minimum file b2=(l2, u2) in level file for which l2 > u1 and
+	// user_key(l2) = user_key(u1)
+	static file_meta_data* find_smallest_boundary_file( const internal_key_comparator&         icmp,
+																											const core::vector< file_meta_data* >& level_files,
+																											const internal_key&                    largest_key ) {
+		const comparator* user_cmp       = icmp.user_comparator();
+		file_meta_data*   smallest_boundary_file = nullptr;
+		for ( size_t i = 0; i < level_files.size(); ++i ) {
+			file_meta_data* f = level_files[ i ];
+			if ( icmp.compare( f->smallest, largest_key ) > 0 &&
+					 user_cmp->compare( f->smallest.user_key(), largest_key.user_key() ) == 0 ) {
+				if ( smallest_boundary_file == nullptr ||
+						 icmp.compare( f->smallest, smallest_boundary_file->smallest ) < 0 ) {
+					smallest_boundary_file = f;
+				}
+			}
+		}
+		return smallest_boundary_file;
+	}
+
+	// Extracts the largest file b1 from |compaction_files| and then searches for a
+	// b2 in |level_files| for which user_key(u1) = user_key(l2). If it finds such a
+	// file b2 (known as a boundary file) it adds it to |compaction_files| and then
+	// searches again using this new upper bound.
+	//
+	// If there are two blocks, b1=(l1, u1) and b2=(l2, u2) and
+	// user_key(u1) = user_key(l2), and if we compact b1 but not b2 then a
+	// subsequent get operation will yield an incorrect result because it will
+	// return the record from b2 in level i rather than from b1 because it searches
+	// level by level for records matching the supplied user key.
+	static void add_boundary_inputs( const internal_key_comparator&         icmp,
+																	 const core::vector< file_meta_data* >& level_files,
+																	 core::vector< file_meta_data* >*       compaction_files ) {
+		internal_key largest_key;
+
+		// Quick return if compaction_files is empty.
+		if ( !find_largest_key( icmp, *compaction_files, &largest_key ) ) {
+			return;
+		}
+
+		bool continue_searching = true;
+		while ( continue_searching ) {
+			file_meta_data* smallest_boundary_file =
+				find_smallest_boundary_file( icmp, level_files, largest_key );
+
+			// If a boundary file was found advance largest_key, otherwise we're done.
+			if ( smallest_boundary_file != nullptr ) {
+				compaction_files->push_back( smallest_boundary_file );
+				largest_key = smallest_boundary_file->largest;
+			} else {
+				continue_searching = false;
+			}
+		}
+	}
+
 
 	class version_set::builder {
 	private:
@@ -182,12 +337,68 @@ namespace simple_leveldb {
 			}
 		}
 
+		// Save the current state in "*v".
 		void save_to( version* v ) {
-			// todo!
+			by_smallest_key cmp;
+			cmp.internal_comparator = &vset_->icmp_;
+			for ( int32_t level = 0; level < config::kNumLevels; level++ ) {
+				// Merge the set of added files with the set of pre-existing files.
+				// Drop any deleted files.  Store the result in *v.
+				const core::vector< file_meta_data* >& base_files = base_->files_[ level ];
+				auto                                   base_iter  = base_files.begin();
+				auto                                   base_end   = base_files.end();
+				const file_set*                        added      = levels_[ level ].added_files;
+				v->files_[ level ].reserve( base_files.size() + added->size() );
+				for ( file_meta_data* added_file: *added ) {
+					// Add all smaller files listed in base_
+					for ( auto bpos = core::upper_bound( base_iter, base_end, added_file, cmp ); base_iter != bpos;
+								++base_iter ) {
+						maybe_add_file( v, level, *base_iter );
+					}
+
+					maybe_add_file( v, level, added_file );
+				}
+
+				// Add remaining base files
+				for ( ; base_iter != base_end; ++base_iter ) {
+					maybe_add_file( v, level, *base_iter );
+				}
+
+#ifndef NDEBUG
+				// Make sure there is no overlap in levels > 0
+				if ( level > 0 ) {
+					for ( size_t i = 1; i < v->files_[ level ].size(); i++ ) {
+						const internal_key& prev_end   = v->files_[ level ][ i - 1 ]->largest;
+						const internal_key& this_begin = v->files_[ level ][ i ]->smallest;
+						assert( vset_->icmp_.compare( prev_end, this_begin ) < 0 );
+					}
+				}
+#endif
+			}
+		}
+
+	private:
+		void maybe_add_file( version* v, int32_t level, file_meta_data* f ) {
+			if ( levels_[ level ].deleted_files.count( f->number ) > 0 ) {
+				// File is deleted: do nothing
+			} else {
+				core::vector< file_meta_data* >* files = &v->files_[ level ];
+				if ( level > 0 && !files->empty() ) {
+					// Must not overlap
+					assert( vset_->icmp_.compare( ( *files )[ files->size() - 1 ]->largest, f->smallest ) < 0 );
+				}
+				f->refs++;
+				files->push_back( f );
+			}
 		}
 	};
 
 	status version_set::log_any_apply( version_edit* edit, port::mutex* mtx ) {
+		while ( manifest_writing_ ) {
+			manifest_written_cv_.wait( *mtx );
+		}
+		manifest_writing_ = true;
+
 		if ( edit->has_log_number_ ) {
 			assert( edit->log_number_ > log_number_ );
 			assert( edit->log_number_ < next_file_number_ );
@@ -258,6 +469,8 @@ namespace simple_leveldb {
 			}
 		}
 
+		manifest_writing_ = false;
+		manifest_written_cv_.notify_all();
 		return s;
 	}
 
@@ -400,6 +613,14 @@ namespace simple_leveldb {
 		}
 	}
 
+	// The pointers stay valid while the current version does.
+	// REQUIRES: mutex held
+	void version_set::get_current_files( core::vector< file_meta_data* >* files ) const {
+		for ( const auto& level: current_->files_ ) {
+			files->insert( files->end(), level.begin(), level.end() );
+		}
+	}
+
 	void version_set::mark_file_number_used( uint64_t number ) {
 		if ( next_file_number_ <= number ) {
 			next_file_number_ = number + 1;
@@ -411,28 +632,649 @@ namespace simple_leveldb {
 		return ( v->compaction_score_ >= 1 ) || ( v->file_to_compact_ != nullptr );
 	}
 
+	// Files that running compactions are already taking out of "level" do
+	// not count towards its score.
+	double version_set::level_score( const version* v, int32_t level ) const {
+		if ( options_->compaction_style == compaction_style::kUniversal && level > 0 ) {
+			// Universal compaction never moves data out of level 0.
+			return 0;
+		}
+		if ( level == 0 ) {
+			// We treat level-0 specially by bounding the number of files
+			// instead of number of bytes.
+			int32_t files = 0;
+			for ( const auto f: v->files_[ level ] ) {
+				if ( !f->being_compacted ) {
+					files++;
+				}
+			}
+			return files / static_cast< double >( config::kL0_CompactionTrigger );
+		}
+		if ( level < v->base_level_ ) {
+			return 0;
+		}
+		uint64_t level_bytes = 0;
+		for ( const auto f: v->files_[ level ] ) {
+			if ( !f->being_compacted ) {
+				level_bytes += f->file_size;
+			}
+		}
+		return static_cast< double >( level_bytes ) / v->level_max_bytes_[ level ];
+	}
+
+	// With level_compaction_dynamic_level_bytes the last level's target is
+	// the size of the largest level, and each level above gets
+	// kLevelSizeMultiplier times less.  The base level, which level 0
+	// compacts into, is the first level in use, moved up while its target
+	// is above kMaxBytesForLevelBase; the levels above it stay empty.  No
+	// target is below kMaxBytesForLevelBase, so a small database fills its
+	// base level before spilling deeper.
+	void version_set::compute_level_targets( version* v ) const {
+		for ( int32_t level = 0; level < config::kNumLevels; level++ ) {
+			v->level_max_bytes_[ level ] = max_bytes_for_level( level );
+		}
+		v->base_level_ = 1;
+		if ( !options_->level_compaction_dynamic_level_bytes ||
+				 options_->compaction_style != compaction_style::kLevel ) {
+			return;
+		}
+
+		int32_t  first_non_empty = -1;
+		uint64_t max_level_bytes = 0;
+		for ( int32_t level = 1; level < config::kNumLevels; level++ ) {
+			const uint64_t bytes = total_file_size( v->files_[ level ] );
+			if ( bytes > 0 && first_non_empty == -1 ) {
+				first_non_empty = level;
+			}
+			max_level_bytes = core::max( max_level_bytes, bytes );
+		}
+
+		const double base_bytes_max = kMaxBytesForLevelBase;
+		const double base_bytes_min = kMaxBytesForLevelBase / kLevelSizeMultiplier;
+		double       base_level_bytes;
+		if ( first_non_empty == -1 ) {
+			// Only level 0 has data: compact it straight into the last level.
+			v->base_level_   = config::kNumLevels - 1;
+			base_level_bytes = base_bytes_max;
+		} else {
+			// Find the target of first_non_empty by dividing down from the
+			// last level, then move the base up while it is too large.
+			double cur_level_bytes = static_cast< double >( max_level_bytes );
+			for ( int32_t level = config::kNumLevels - 2; level >= first_non_empty; level-- ) {
+				cur_level_bytes /= kLevelSizeMultiplier;
+			}
+			v->base_level_ = first_non_empty;
+			while ( v->base_level_ > 1 && cur_level_bytes > base_bytes_max ) {
+				v->base_level_--;
+				cur_level_bytes /= kLevelSizeMultiplier;
+			}
+			base_level_bytes = core::max( cur_level_bytes, base_bytes_min );
+		}
+
+		double level_bytes = base_level_bytes;
+		for ( int32_t level = v->base_level_; level < config::kNumLevels; level++ ) {
+			if ( level > v->base_level_ ) {
+				level_bytes *= kLevelSizeMultiplier;
+			}
+			v->level_max_bytes_[ level ] = core::max( level_bytes, base_bytes_max );
+		}
+	}
+
 	void version_set::finalize( version* v ) {
+		compute_level_targets( v );
+
 		int32_t best_level = -1;
 		double  best_score = -1;
 
 		for ( int32_t level = 0; level < config::kNumLevels - 1; level++ ) {
-			double score;
-			if ( level == 0 ) {
-				score = v->files_[ level ].size() / static_cast< double >( config::kL0_CompactionTrigger );
+			const double score = level_score( v, level );
+			if ( score > best_score ) {
+				best_level = level;
+				best_score = score;
+			}
+		}
+
+		v->compaction_level_ = best_level;
+		v->compaction_score_ = best_score;
+
+		if ( v->file_to_compact_ == nullptr ) {
+			mark_file_for_compaction( v );
+		}
+	}
+
+	// Set v->file_to_compact_ to the table furthest past
+	// deletion_ratio_compaction_trigger or periodic_compaction_seconds, if
+	// any.  Tables taken by running compactions are skipped; their outputs
+	// are looked at again when the compaction installs its version.
+	void version_set::mark_file_for_compaction( version* v ) const {
+		static const uint64_t kMinEntriesForDeletionTrigger = 128;
+		const double          deletion_ratio                = options_->deletion_ratio_compaction_trigger;
+		const uint64_t        max_age                       = options_->periodic_compaction_seconds;
+		if ( options_->compaction_style != compaction_style::kLevel || ( deletion_ratio <= 0 && max_age == 0 ) ) {
+			return;
+		}
+
+		const uint64_t now        = env_->now_micros() / 1000000;
+		double         best_score = 0;
+		for ( int32_t level = 0; level < config::kNumLevels - 1; level++ ) {
+			for ( file_meta_data* f: v->files_[ level ] ) {
+				if ( f->being_compacted ) {
+					continue;
+				}
+				// How far past its threshold the table is; >= 1 if it is.
+				const table_properties& props = f->properties;
+				double                  score = 0;
+				if ( deletion_ratio > 0 && props.num_entries >= kMinEntriesForDeletionTrigger ) {
+					score = static_cast< double >( props.num_deletions ) / props.num_entries / deletion_ratio;
+				}
+				if ( max_age > 0 && props.creation_time != 0 && props.creation_time < now ) {
+					score = core::max( score, static_cast< double >( now - props.creation_time ) / max_age );
+				}
+				if ( score >= 1 && score > best_score ) {
+					best_score                  = score;
+					v->file_to_compact_         = f;
+					v->file_to_compact_level_   = level;
+					v->rewrite_file_to_compact_ = true;
+				}
+			}
+		}
+	}
+
+	// Stores the minimal range that covers all entries in inputs in
+	// *smallest, *largest.
+	// REQUIRES: inputs is not empty
+	void version_set::get_range( const core::vector< file_meta_data* >& inputs, internal_key* smallest,
+															 internal_key* largest ) {
+		assert( !inputs.empty() );
+		smallest->clear();
+		largest->clear();
+		for ( size_t i = 0; i < inputs.size(); i++ ) {
+			file_meta_data* f = inputs[ i ];
+			if ( i == 0 ) {
+				*smallest = f->smallest;
+				*largest  = f->largest;
 			} else {
-				const uint64_t level_bytes = total_file_size( v->files_[ level ] );
-				score =
-					static_cast< double >( level_bytes ) / max_bytes_for_level( options_, level );
+				if ( icmp_.compare( f->smallest, *smallest ) < 0 ) {
+					*smallest = f->smallest;
+				}
+				if ( icmp_.compare( f->largest, *largest ) > 0 ) {
+					*largest = f->largest;
+				}
+			}
+		}
+	}
+
+	// Stores the minimal range that covers all entries in inputs1 and inputs2
+	// in *smallest, *largest.
+	// REQUIRES: inputs is not empty
+	void version_set::get_range2( const core::vector< file_meta_data* >& inputs1,
+																const core::vector< file_meta_data* >& inputs2, internal_key* smallest,
+																internal_key* largest ) {
+		core::vector< file_meta_data* > all = inputs1;
+		all.insert( all.end(), inputs2.begin(), inputs2.end() );
+		get_range( all, smallest, largest );
+	}
 
-				if ( score > best_score ) {
-					best_level = level;
-					best_score = score;
+	void version_set::setup_other_inputs( compaction* c ) {
+		const int32_t level = c->level();
+		internal_key  smallest, largest;
+
+		add_boundary_inputs( icmp_, current_->files_[ level ], &c->input_[ 0 ] );
+		get_range( c->input_[ 0 ], &smallest, &largest );
+
+		const int32_t output_level = c->output_level();
+		current_->get_overlapping_inputs( output_level, &smallest, &largest, &c->input_[ 1 ] );
+		add_boundary_inputs( icmp_, current_->files_[ output_level ], &c->input_[ 1 ] );
+
+		// Get entire range covered by compaction
+		internal_key all_start, all_limit;
+		get_range2( c->input_[ 0 ], c->input_[ 1 ], &all_start, &all_limit );
+
+		// See if we can grow the number of inputs in "level" without
+		// changing the number of "output_level" files we pick up.  Files that a
+		// running compaction holds are never grown into.
+		if ( !c->input_[ 1 ].empty() ) {
+			core::vector< file_meta_data* > expanded0;
+			current_->get_overlapping_inputs( level, &all_start, &all_limit, &expanded0 );
+			add_boundary_inputs( icmp_, current_->files_[ level ], &expanded0 );
+			const int64_t inputs1_size   = total_file_size( c->input_[ 1 ] );
+			const int64_t expanded0_size = total_file_size( expanded0 );
+			if ( expanded0.size() > c->input_[ 0 ].size() && !any_being_compacted( expanded0 ) &&
+					 inputs1_size + expanded0_size < expanded_compaction_byte_size_limit( options_ ) ) {
+				internal_key new_start, new_limit;
+				get_range( expanded0, &new_start, &new_limit );
+				core::vector< file_meta_data* > expanded1;
+				current_->get_overlapping_inputs( output_level, &new_start, &new_limit, &expanded1 );
+				add_boundary_inputs( icmp_, current_->files_[ output_level ], &expanded1 );
+				if ( expanded1.size() == c->input_[ 1 ].size() ) {
+					Log( options_->info_log, "Expanding@%d %d+%d (%ld+%ld bytes) to %d+%d (%ld+%ld bytes)\n",
+							 level, int( c->input_[ 0 ].size() ), int( c->input_[ 1 ].size() ),
+							 long( total_file_size( c->input_[ 0 ] ) ), long( inputs1_size ), int( expanded0.size() ),
+							 int( expanded1.size() ), long( expanded0_size ), long( inputs1_size ) );
+					c->input_[ 0 ] = expanded0;
+					c->input_[ 1 ] = expanded1;
+					get_range2( c->input_[ 0 ], c->input_[ 1 ], &all_start, &all_limit );
 				}
 			}
 		}
 
-		v->compaction_level_ = best_level;
-		v->compaction_score_ = best_score;
+		// Compute the set of grandparent files that overlap this compaction
+		// (parent == output_level; grandparent == output_level+1)
+		if ( output_level + 1 < config::kNumLevels ) {
+			current_->get_overlapping_inputs( output_level + 1, &all_start, &all_limit, &c->grandparents_ );
+		}
+	}
+
+	// True if "c" shares an input file with a running compaction, or would
+	// write into the key range another running compaction is writing in
+	// the same level.  Outputs of different levels cannot collide: a
+	// running compaction's inputs are marked, so any file both would touch
+	// is caught by the first test.
+	bool version_set::conflicts_with_running( compaction* c ) {
+		if ( any_being_compacted( c->input_[ 0 ] ) || any_being_compacted( c->input_[ 1 ] ) ) {
+			return true;
+		}
+		if ( running_compactions_.empty() ) {
+			return false;
+		}
+
+		const comparator* user_cmp = icmp_.user_comparator();
+		internal_key      smallest, largest;
+		get_range2( c->input_[ 0 ], c->input_[ 1 ], &smallest, &largest );
+		for ( compaction* r: running_compactions_ ) {
+			if ( r->output_level() != c->output_level() ) {
+				continue;
+			}
+			internal_key r_smallest, r_largest;
+			get_range2( r->input_[ 0 ], r->input_[ 1 ], &r_smallest, &r_largest );
+			if ( user_cmp->compare( largest.user_key(), r_smallest.user_key() ) >= 0 &&
+					 user_cmp->compare( smallest.user_key(), r_largest.user_key() ) <= 0 ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Complete "c", whose input_[0] holds the files it was picked for, and
+	// register it as running.  If it collides with a running compaction
+	// instead, delete it and return false.
+	bool version_set::claim_compaction( compaction* c ) {
+		c->input_version_ = current_;
+		c->input_version_->ref();
+		if ( c->level() == 0 ) {
+			c->output_level_ = current_->base_level_;
+		}
+
+		// Files in level 0 may overlap each other, so pick up all overlapping ones
+		if ( c->level() == 0 ) {
+			internal_key smallest, largest;
+			get_range( c->input_[ 0 ], &smallest, &largest );
+			// Note that the next call will discard the file we placed in
+			// c->input_[0] earlier and replace it with an overlapping set
+			// which will include the picked file.
+			current_->get_overlapping_inputs( 0, &smallest, &largest, &c->input_[ 0 ] );
+			assert( !c->input_[ 0 ].empty() );
+		}
+
+		setup_other_inputs( c );
+		if ( conflicts_with_running( c ) ) {
+			delete c;
+			return false;
+		}
+		add_running( c );
+
+		// Update the place where we will do the next compaction for this level.
+		// We update this immediately instead of waiting for the VersionEdit
+		// to be applied so that if the compaction fails, we will try a different
+		// key range next time.
+		internal_key smallest, largest;
+		get_range( c->input_[ 0 ], &smallest, &largest );
+		compact_pointer_[ c->level() ] = largest.encode().to_string();
+		c->edit_.set_compact_pointer( c->level(), largest );
+		return true;
+	}
+
+	// REQUIRES: "c" does not conflict with a running compaction
+	void version_set::add_running( compaction* c ) {
+		for ( const auto& files: c->input_ ) {
+			for ( file_meta_data* f: files ) {
+				f->being_compacted = true;
+			}
+		}
+		running_compactions_.push_back( c );
+	}
+
+	// Store the files of "level" in "*candidates" in the order
+	// options::compaction_pri tries them.  Level 0 always goes round-robin:
+	// its files overlap, so claim_compaction() takes most of them anyway.
+	void version_set::order_candidates( int32_t level, core::vector< file_meta_data* >* candidates ) const {
+		const core::vector< file_meta_data* >& files = current_->files_[ level ];
+		candidates->clear();
+		if ( options_->compaction_pri == compaction_pri::kMinOverlappingRatio && level > 0 &&
+				 level + 1 < config::kNumLevels ) {
+			// Both levels are sorted and disjoint, so one pass over the next
+			// level finds every overlap.
+			const core::vector< file_meta_data* >&                  next = current_->files_[ level + 1 ];
+			const comparator*                                       ucmp = icmp_.user_comparator();
+			core::vector< core::pair< uint64_t, file_meta_data* > > scored;
+			size_t                                                  j = 0;
+			for ( file_meta_data* f: files ) {
+				while ( j < next.size() && ucmp->compare( next[ j ]->largest.user_key(), f->smallest.user_key() ) < 0 ) {
+					j++;
+				}
+				uint64_t overlapping_bytes = 0;
+				for ( size_t k = j;
+							k < next.size() && ucmp->compare( next[ k ]->smallest.user_key(), f->largest.user_key() ) <= 0;
+							k++ ) {
+					overlapping_bytes += next[ k ]->file_size;
+				}
+				scored.emplace_back( overlapping_bytes * 1024 / core::max< uint64_t >( f->file_size, 1 ), f );
+			}
+			core::stable_sort( scored.begin(), scored.end(),
+												 []( const auto& a, const auto& b ) { return a.first < b.first; } );
+			for ( const auto& [ ratio, f ]: scored ) {
+				candidates->push_back( f );
+			}
+			return;
+		}
+
+		size_t start = 0;
+		if ( !compact_pointer_[ level ].empty() ) {
+			while ( start < files.size() &&
+							icmp_.compare( files[ start ]->largest.encode(), compact_pointer_[ level ] ) <= 0 ) {
+				start++;
+			}
+		}
+		for ( size_t k = 0; k < files.size(); k++ ) {
+			candidates->push_back( files[ ( start + k ) % files.size() ] );
+		}
+	}
+
+	compaction* version_set::pick_level_compaction( int32_t level ) {
+		core::vector< file_meta_data* > candidates;
+		order_candidates( level, &candidates );
+		for ( file_meta_data* f: candidates ) {
+			if ( f->being_compacted ) {
+				continue;
+			}
+			compaction* c = new compaction( options_, level );
+			c->input_[ 0 ].push_back( f );
+			if ( claim_compaction( c ) ) {
+				return c;
+			}
+		}
+		return nullptr;
+	}
+
+	// Universal compaction treats every level-0 file as a sorted run and
+	// only merges a prefix of the runs ordered newest first.  The output
+	// goes back to level 0 as a single file under a file number newer than
+	// all inputs, so ordering level-0 files by number stays correct.  For
+	// the same reason only one universal compaction runs at a time.
+	//
+	// Tried in order:
+	//  1. If the runs newer than the oldest add up to more than
+	//     max_size_amplification_percent of it, merge all runs.
+	//  2. Merge the newest runs while the next older run is no more than
+	//     size_ratio percent larger than those picked so far.
+	//  3. Merge just enough of the newest runs to get back under the trigger.
+	// "manual" merges all runs.
+	compaction* version_set::pick_universal_compaction( bool manual ) {
+		const compaction_options_universal& opt = options_->compaction_options_universal;
+
+		core::vector< file_meta_data* > runs = current_->files_[ 0 ];
+		if ( any_being_compacted( runs ) ) {
+			return nullptr;
+		}
+		core::sort( runs.begin(), runs.end(),
+								[]( const file_meta_data* a, const file_meta_data* b ) { return a->number > b->number; } );
+		const size_t num_runs = runs.size();
+		if ( num_runs < 2 || ( !manual && num_runs < static_cast< size_t >( config::kL0_CompactionTrigger ) ) ) {
+			return nullptr;
+		}
+
+		const size_t min_width = core::max< size_t >( 2, opt.min_merge_width );
+		const size_t max_width = core::max< size_t >( min_width, opt.max_merge_width );
+		size_t       count     = 0;
+		const char*  reason    = nullptr;
+
+		uint64_t newer_bytes = 0;
+		for ( size_t i = 0; i + 1 < num_runs; i++ ) {
+			newer_bytes += runs[ i ]->file_size;
+		}
+		const uint64_t oldest_bytes = runs.back()->file_size;
+		if ( manual ) {
+			count  = num_runs;
+			reason = "manual";
+		} else if ( newer_bytes * 100 >= oldest_bytes * opt.max_size_amplification_percent ) {
+			count  = num_runs;
+			reason = "space amplification";
+		} else {
+			uint64_t picked_bytes = runs[ 0 ]->file_size;
+			size_t   n            = 1;
+			while ( n < num_runs && n < max_width &&
+							runs[ n ]->file_size * 100 <= picked_bytes * ( 100 + opt.size_ratio ) ) {
+				picked_bytes += runs[ n ]->file_size;
+				n++;
+			}
+			if ( n >= min_width ) {
+				count  = n;
+				reason = "size ratio";
+			} else {
+				count  = core::min( num_runs, core::max( min_width, num_runs - config::kL0_CompactionTrigger + 2 ) );
+				reason = "sorted run count";
+			}
+		}
+
+		compaction* c            = new compaction( options_, 0 );
+		c->output_level_         = 0;
+		c->has_older_runs_       = ( count < num_runs );
+		c->max_output_file_size_ = UINT64_MAX;// One run in, one file out
+		c->input_version_        = current_;
+		c->input_version_->ref();
+		c->input_[ 0 ].assign( runs.begin(), runs.begin() + count );
+		add_running( c );
+		Log( options_->info_log, "Universal compaction of %d of %d runs (%s)\n", static_cast< int >( count ),
+				 static_cast< int >( num_runs ), reason );
+		return c;
+	}
+
+	compaction* version_set::pick_compaction() {
+		if ( options_->compaction_style == compaction_style::kUniversal ) {
+			return pick_universal_compaction( false );
+		}
+
+		version* const v = current_;
+
+		// Size compactions first, most urgent level first.  A level all of
+		// whose candidates are held up by running compactions yields to the
+		// next one, so deep levels make progress while a long compaction
+		// runs elsewhere.
+		core::vector< core::pair< double, int32_t > > levels;
+		for ( int32_t level = 0; level < config::kNumLevels - 1; level++ ) {
+			const double score = level_score( v, level );
+			if ( score >= 1 ) {
+				levels.emplace_back( score, level );
+			}
+		}
+		core::sort( levels.begin(), levels.end(), []( const auto& a, const auto& b ) { return a.first > b.first; } );
+		for ( const auto& [ score, level ]: levels ) {
+			compaction* c = pick_level_compaction( level );
+			if ( c != nullptr ) {
+				return c;
+			}
+		}
+
+		// Then seek compactions, or a table marked by finalize().
+		if ( v->file_to_compact_ != nullptr && !v->file_to_compact_->being_compacted ) {
+			compaction* c = new compaction( options_, v->file_to_compact_level_ );
+			c->input_[ 0 ].push_back( v->file_to_compact_ );
+			c->must_rewrite_ = v->rewrite_file_to_compact_;
+			if ( claim_compaction( c ) ) {
+				return c;
+			}
+		}
+		return nullptr;
+	}
+
+	compaction* version_set::compact_range( int32_t level, const internal_key* begin, const internal_key* end,
+																					bool* conflict ) {
+		*conflict = false;
+		if ( options_->compaction_style == compaction_style::kUniversal ) {
+			if ( level != 0 || current_->files_[ 0 ].size() < 2 ) {
+				return nullptr;
+			}
+			compaction* c = pick_universal_compaction( true );
+			*conflict     = ( c == nullptr );
+			return c;
+		}
+
+		core::vector< file_meta_data* > inputs;
+		current_->get_overlapping_inputs( level, begin, end, &inputs );
+		if ( inputs.empty() ) {
+			return nullptr;
+		}
+
+		// Avoid compacting too much in one shot in case the range is large.
+		// But we cannot do this for level-0 since level-0 files can overlap
+		// and we must not pick one file and drop another older file if the
+		// two files overlap.
+		if ( level > 0 ) {
+			const uint64_t limit = max_file_size_for_level( options_, level );
+			uint64_t       total = 0;
+			for ( size_t i = 0; i < inputs.size(); i++ ) {
+				uint64_t s  = inputs[ i ]->file_size;
+				total      += s;
+				if ( total >= limit ) {
+					inputs.resize( i + 1 );
+					break;
+				}
+			}
+		}
+
+		compaction* c  = new compaction( options_, level );
+		c->input_[ 0 ] = inputs;
+		if ( !claim_compaction( c ) ) {
+			*conflict = true;
+			return nullptr;
+		}
+		return c;
+	}
+
+	namespace {
+
+		// An internal iterator.  For a given version/level pair, yields
+		// information about the files in the level.  For a given entry, key()
+		// is the largest key that occurs in the file, and value() is an
+		// 16-byte value containing the file number and file size, both
+		// encoded using encode_fixed64.
+		class level_file_num_iterator : public iterator {
+		private:
+			const internal_key_comparator                icmp_;
+			const core::vector< file_meta_data* >* const flist_;
+			uint32_t                                     index_;
+
+			// Backing store for value().  Holds the file number and size.
+			mutable char value_buf_[ 16 ];
+
+		public:
+			level_file_num_iterator( const internal_key_comparator&         icmp,
+															 const core::vector< file_meta_data* >* flist )
+					: icmp_( icmp )
+					, flist_( flist )
+					, index_( flist->size() ) {}// Marks as invalid
+
+		public:
+			bool valid() const override { return index_ < flist_->size(); }
+
+			void seek( const slice& target ) override {
+				// Index of the first file whose largest key is at or past "target".
+				uint32_t left  = 0;
+				uint32_t right = flist_->size();
+				while ( left < right ) {
+					const uint32_t mid = ( left + right ) / 2;
+					if ( icmp_.compare( ( *flist_ )[ mid ]->largest.encode(), target ) < 0 ) {
+						left = mid + 1;
+					} else {
+						right = mid;
+					}
+				}
+				index_ = right;
+			}
+
+			void seek_to_first() override { index_ = 0; }
+
+			void seek_to_last() override { index_ = flist_->empty() ? 0 : flist_->size() - 1; }
+
+			void next() override {
+				assert( valid() );
+				index_++;
+			}
+
+			void prev() override {
+				assert( valid() );
+				if ( index_ == 0 ) {
+					index_ = flist_->size();// Marks as invalid
+				} else {
+					index_--;
+				}
+			}
+
+			slice key() const override {
+				assert( valid() );
+				return ( *flist_ )[ index_ ]->largest.encode();
+			}
+
+			slice value() const override {
+				assert( valid() );
+				encode_fixed64( value_buf_, ( *flist_ )[ index_ ]->number );
+				encode_fixed64( value_buf_ + 8, ( *flist_ )[ index_ ]->file_size );
+				return slice( value_buf_, sizeof( value_buf_ ) );
+			}
+
+			status get_status() const override { return status::ok(); }
+		};
+
+	}// end anonymous namespace
+
+	iterator* version_set::make_input_iterator( compaction* c ) {
+		read_options options;
+		options.verify_checksums = options_->paranoid_checks;
+		options.fill_cache       = false;
+
+		table_cache* const cache     = table_cache_;
+		auto               open_file = [ cache, options ]( const slice& file_value ) {
+			if ( file_value.size() != 16 ) {
+				return new_error_iterator( status::corruption( "file reader invoked with unexpected value" ) );
+			}
+			return cache->new_iterator( options, decode_fixed64( file_value.data() ),
+																	decode_fixed64( file_value.data() + 8 ) );
+		};
+
+		// Level-0 files have to be merged together.  For other levels,
+		// we will make a concatenating iterator per level.
+		const int32_t space = ( c->level() == 0 ? c->input_[ 0 ].size() + 1 : 2 );
+		iterator**    list  = new iterator*[ space ];
+		int32_t       num   = 0;
+		for ( int32_t which = 0; which < 2; which++ ) {
+			if ( c->input_[ which ].empty() ) {
+				continue;
+			}
+			const int32_t level = ( which == 0 ? c->level() : c->output_level() );
+			if ( level == 0 ) {
+				for ( file_meta_data* f: c->input_[ which ] ) {
+					list[ num++ ] = table_cache_->new_iterator( options, f->number, f->file_size );
+				}
+			} else {
+				// Create concatenating iterator for the files from this level
+				list[ num++ ] = new_two_level_iterator( new level_file_num_iterator( icmp_, &c->input_[ which ] ),
+																								open_file );
+			}
+		}
+		assert( num <= space );
+		iterator* result = new_merging_iterator( &icmp_, list, num );
+		delete[] list;
+		return result;
 	}
 
 	status version_set::write_snap_shot( log::writer* log ) {
@@ -450,7 +1292,8 @@ namespace simple_leveldb {
 
 		for ( int32_t level = 0; auto& files: current_->files_ ) {
 			for ( auto file: files ) {
-				edit.add_file( level, file->number, file->file_size, file->smallest, file->largest );
+				edit.add_file( level, file->number, file->file_size, file->smallest, file->largest,
+											 file->properties );
 			}
 			level++;
 		}
@@ -507,3 +1350,195 @@ namespace simple_leveldb {
 	}
 
 }// namespace simple_leveldb
+
+namespace simple_leveldb {
+
+	compaction::compaction( const options* options, int32_t level )
+			: level_( level )
+			, output_level_( level + 1 )
+			, has_older_runs_( false )
+			, must_rewrite_( false )
+			, max_output_file_size_( max_file_size_for_level( options, level ) )
+			, input_version_( nullptr ) {}
+
+	compaction::~compaction() {
+		if ( input_version_ != nullptr ) {
+			release_inputs();
+		}
+	}
+
+	int32_t compaction::level() const { return level_; }
+
+	int32_t compaction::output_level() const { return output_level_; }
+
+	version_edit* compaction::edit() { return &edit_; }
+
+	int32_t compaction::num_input_files( int32_t which ) const {
+		return static_cast< int32_t >( input_[ which ].size() );
+	}
+
+	file_meta_data* compaction::input( int32_t which, int32_t i ) const { return input_[ which ][ i ]; }
+
+	uint64_t compaction::max_output_file_size() const { return max_output_file_size_; }
+
+	bool compaction::is_trivial_move() const {
+		const version_set* vset = input_version_->vset_;
+		// Avoid a move if there is lots of overlapping grandparent data.
+		// Otherwise, the move could create a parent file that will require
+		// a very expensive merge later on.
+		return ( !must_rewrite_ && output_level_ != level_ && num_input_files( 0 ) == 1 &&
+						 num_input_files( 1 ) == 0 &&
+						 total_file_size( grandparents_ ) <= max_grand_parent_overlap_bytes( vset->options_ ) );
+	}
+
+	void compaction::add_input_deletions( version_edit* edit ) {
+		for ( int32_t which = 0; which < 2; which++ ) {
+			for ( size_t i = 0; i < input_[ which ].size(); i++ ) {
+				edit->remove_file( which == 0 ? level_ : output_level_, input_[ which ][ i ]->number );
+			}
+		}
+	}
+
+	// Also hands the inputs back for other compactions to pick.
+	// REQUIRES: mutex held
+	void compaction::release_inputs() {
+		if ( input_version_ == nullptr ) {
+			return;
+		}
+		core::vector< compaction* >& running = input_version_->vset_->running_compactions_;
+		auto                         it      = core::find( running.begin(), running.end(), this );
+		if ( it != running.end() ) {
+			running.erase( it );
+			for ( const auto& files: input_ ) {
+				for ( file_meta_data* f: files ) {
+					f->being_compacted = false;
+				}
+			}
+		}
+		input_version_->un_ref();
+		input_version_ = nullptr;
+	}
+
+	bool compaction::is_base_level_for_key( const slice& user_key, cursor* cursor ) const {
+		if ( has_older_runs_ ) {
+			return false;
+		}
+		// Maybe use binary search to find right entry instead of linear search?
+		const comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+		for ( int32_t lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++ ) {
+			const core::vector< file_meta_data* >& files = input_version_->files_[ lvl ];
+			while ( cursor->level_ptrs[ lvl ] < files.size() ) {
+				file_meta_data* f = files[ cursor->level_ptrs[ lvl ] ];
+				if ( user_cmp->compare( user_key, f->largest.user_key() ) <= 0 ) {
+					// We've advanced far enough
+					if ( user_cmp->compare( user_key, f->smallest.user_key() ) >= 0 ) {
+						// Key falls in this file's range, so definitely not base level
+						return false;
+					}
+					break;
+				}
+				cursor->level_ptrs[ lvl ]++;
+			}
+		}
+		return true;
+	}
+
+	// True if no level below the output holds data, so the outputs keep the
+	// oldest values of the input keys.
+	bool compaction::is_bottommost_level() const {
+		if ( has_older_runs_ ) {
+			return false;
+		}
+		for ( int32_t lvl = output_level_ + 1; lvl < config::kNumLevels; lvl++ ) {
+			if ( !input_version_->files_[ lvl ].empty() ) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool compaction::should_stop_before( const slice& internal_key, cursor* cursor ) const {
+		const version_set*             vset = input_version_->vset_;
+		const internal_key_comparator* icmp = &vset->icmp_;
+		// Scan to find earliest grandparent file that contains key.
+		while ( cursor->grandparent_index < grandparents_.size() &&
+						icmp->compare( internal_key, grandparents_[ cursor->grandparent_index ]->largest.encode() ) > 0 ) {
+			if ( cursor->seen_key ) {
+				cursor->overlapped_bytes += grandparents_[ cursor->grandparent_index ]->file_size;
+			}
+			cursor->grandparent_index++;
+		}
+		cursor->seen_key = true;
+
+		if ( cursor->overlapped_bytes > max_grand_parent_overlap_bytes( vset->options_ ) ) {
+			// Too much overlap for current output; start new output
+			cursor->overlapped_bytes = 0;
+			return true;
+		} else {
+			return false;
+		}
+	}
+
+	void compaction::get_subcompaction_boundaries( int32_t                       max_subcompactions,
+																								 core::vector< core::string >* boundaries ) const {
+		boundaries->clear();
+		if ( max_subcompactions <= 1 || output_level_ == level_ ) {
+			// A level-0 output must stay a single file.
+			return;
+		}
+
+		// Candidate boundaries are the user keys at which input files start
+		// or end.  Splitting on user keys keeps every version of a key in
+		// one subcompaction, which dropping shadowed entries relies on.
+		const comparator*     user_cmp = input_version_->vset_->icmp_.user_comparator();
+		core::vector< slice > keys;
+		for ( const auto& files: input_ ) {
+			for ( const file_meta_data* f: files ) {
+				keys.push_back( f->smallest.user_key() );
+				keys.push_back( f->largest.user_key() );
+			}
+		}
+		auto less = [ user_cmp ]( const slice& a, const slice& b ) { return user_cmp->compare( a, b ) < 0; };
+		core::sort( keys.begin(), keys.end(), less );
+		keys.erase( core::unique( keys.begin(), keys.end(),
+															[ user_cmp ]( const slice& a, const slice& b ) { return user_cmp->compare( a, b ) == 0; } ),
+								keys.end() );
+		if ( keys.size() < 3 ) {
+			return;
+		}
+
+		// Estimate the input bytes between each pair of neighbouring
+		// candidates, assuming each file is spread evenly over its range.
+		const size_t             num_ranges = keys.size() - 1;
+		core::vector< uint64_t > range_bytes( num_ranges, 0 );
+		uint64_t                 total_bytes = 0;
+		for ( const auto& files: input_ ) {
+			for ( const file_meta_data* f: files ) {
+				const size_t lo =
+					core::lower_bound( keys.begin(), keys.end(), f->smallest.user_key(), less ) - keys.begin();
+				const size_t hi =
+					core::lower_bound( keys.begin(), keys.end(), f->largest.user_key(), less ) - keys.begin();
+				if ( lo == hi ) {
+					range_bytes[ core::min( lo, num_ranges - 1 ) ] += f->file_size;
+				} else {
+					for ( size_t i = lo; i < hi; i++ ) {
+						range_bytes[ i ] += f->file_size / ( hi - lo );
+					}
+				}
+				total_bytes += f->file_size;
+			}
+		}
+
+		// Cut after a range once the bytes so far reach the next multiple of
+		// total_bytes / n.  Never cut after the last range.
+		const uint64_t n = core::min< uint64_t >( max_subcompactions, num_ranges );
+		uint64_t       sum = 0;
+		for ( size_t i = 0; i + 1 < num_ranges && boundaries->size() + 1 < n; i++ ) {
+			sum += range_bytes[ i ];
+			if ( sum * n >= total_bytes * ( boundaries->size() + 1 ) ) {
+				boundaries->push_back( keys[ i + 1 ].to_string() );
+			}
+		}
+	}
+
+}// namespace simple_leveldb
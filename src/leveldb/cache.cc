@@ -7,7 +7,8 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
-#include <functional>
+#include <cstring>
+#include <vector>
 
 #include "leveldb/slice.h"
 #include "port/thread_annotations.h"
@@ -18,6 +19,56 @@ namespace simple_leveldb {
 
 	cache::~cache() {}
 
+	cache::handle* cache::insert_item( const slice& key, void* value, size_t charge,
+																		 const item_helper* helper, priority priority ) {
+		return insert( key, value, charge, helper->deleter, priority );
+	}
+
+	cache::handle* cache::look_up_item( const slice& key, const item_helper* ) {
+		return look_up( key );
+	}
+
+	void cache::stats::add( const stats& other ) {
+		hits           += other.hits;
+		misses         += other.misses;
+		inserts        += other.inserts;
+		evictions      += other.evictions;
+		failed_inserts += other.failed_inserts;
+		usage          += other.usage;
+		pinned_usage   += other.pinned_usage;
+	}
+
+	void cache::get_shard_stats( int, stats* stats ) const {
+		*stats       = cache::stats();
+		stats->usage = total_charge();
+	}
+
+	void cache::get_stats( stats* stats ) const {
+		*stats = cache::stats();
+		for ( int s = 0; s < shard_count(); s++ ) {
+			cache::stats shard;
+			get_shard_stats( s, &shard );
+			stats->add( shard );
+		}
+	}
+
+	void cache::record_block_look_up( block_type type, bool hit ) {
+		block_counters& c = block_counters_[ static_cast< int >( type ) ];
+		( hit ? c.hits : c.misses ).fetch_add( 1, core::memory_order_relaxed );
+	}
+
+	void cache::record_block_insert( block_type type ) {
+		block_counters_[ static_cast< int >( type ) ].inserts.fetch_add( 1, core::memory_order_relaxed );
+	}
+
+	void cache::get_block_stats( block_type type, stats* stats ) const {
+		const block_counters& c = block_counters_[ static_cast< int >( type ) ];
+		*stats                  = cache::stats();
+		stats->hits             = c.hits.load( core::memory_order_relaxed );
+		stats->misses           = c.misses.load( core::memory_order_relaxed );
+		stats->inserts          = c.inserts.load( core::memory_order_relaxed );
+	}
+
 	namespace {
 
 		// LRU cache implementation
@@ -38,21 +89,39 @@ namespace simple_leveldb {
 		// Elements are moved between these lists by the Ref() and Unref() methods,
 		// when they detect an element in the cache acquiring or losing its only
 		// external reference.
-
-		// An entry is a variable length heap-allocated structure.  Entries
-		// are kept in a circular doubly linked list ordered by access time.
+		//
+		// The LRU list is split in two pools.  The newest part is the high-priority
+		// pool, bounded by high_pri_pool_ratio of the capacity; lru_low_pri_ marks the
+		// newest entry of the low-priority pool behind it.  Entries inserted with
+		// priority::kHigh, and entries that were looked up at least once, go to the
+		// head of the high-priority pool.  Everything else is inserted at the
+		// midpoint, the head of the low-priority pool, so a scan of one-shot blocks
+		// only churns the low-priority pool.  When the high-priority pool overflows
+		// its oldest entries move to the low-priority pool.  With a ratio of 0 the
+		// high-priority pool is always empty and this is plain LRU.
+
+		// An entry is a fixed size structure handed out by a handle_pool.  Keys
+		// up to kInlineKeySize bytes (block cache keys are 16) are stored in the
+		// entry itself; longer keys get their own heap allocation.  Entries are
+		// kept in a circular doubly linked list ordered by access time.
 		struct lru_handle {
-			void*                                         value;
-			core::function< void( const slice&, void* ) > deleter;
-			lru_handle*                                   next_hash;
-			lru_handle*                                   next;
-			lru_handle*                                   prev;
-			size_t                                        charge;// TODO(opt): Only allow uint32_t?
-			size_t                                        key_length;
-			bool                                          in_cache;     // Whether entry is in the cache.
-			uint32_t                                      refs;         // References, including cache reference, if present.
-			uint32_t                                      hash;         // Hash of key(); used for fast sharding and comparisons
-			char                                          key_data[ 1 ];// Beginning of key
+			static constexpr size_t kInlineKeySize = 24;
+
+			void*               value;
+			cache::deleter_type deleter;
+			lru_handle*         next_hash;
+			lru_handle*         next;
+			lru_handle*         prev;
+			size_t              charge;// TODO(opt): Only allow uint32_t?
+			size_t              key_length;
+			char*               key_data;// key_inline or a malloc'ed copy of a long key
+			bool                in_cache;        // Whether entry is in the cache.
+			bool                is_high_pri;     // Inserted with priority::kHigh.
+			bool                has_hit;         // Looked up since it was inserted.
+			bool                in_high_pri_pool;// On lru_ in the high-priority pool.
+			uint32_t            refs;            // References, including cache reference, if present.
+			uint32_t            hash;            // Hash of key(); used for fast sharding and comparisons
+			char                key_inline[ kInlineKeySize ];
 
 			slice key() const {
 				// next is only equal to this if the LRU handle is the list head of an
@@ -61,6 +130,67 @@ namespace simple_leveldb {
 
 				return slice( key_data, key_length );
 			}
+
+			void set_key( const slice& key ) {
+				key_length = key.size();
+				key_data   = key.size() <= kInlineKeySize ? key_inline
+																									: reinterpret_cast< char* >( malloc( key.size() ) );
+				std::memcpy( key_data, key.data(), key.size() );
+			}
+
+			void free_key() {
+				if ( key_data != key_inline ) {
+					free( key_data );
+				}
+			}
+		};
+
+		// Allocator for the lru_handles of one shard.  Handles are carved out of
+		// slabs of kHandlesPerSlab and recycled through a free list threaded
+		// through next_hash, so steady-state inserts do not call malloc.  Slabs
+		// are only returned to the system when the pool is destroyed.
+		//
+		// Not thread-safe; the owning shard's mutex serializes all calls.
+		class handle_pool {
+		public:
+			handle_pool()
+					: free_( nullptr ) {}
+			~handle_pool() {
+				for ( lru_handle* slab: slabs_ ) {
+					delete[] slab;
+				}
+			}
+
+			handle_pool( const handle_pool& )            = delete;
+			handle_pool& operator=( const handle_pool& ) = delete;
+
+			lru_handle* allocate() {
+				if ( free_ == nullptr ) {
+					grow();
+				}
+				lru_handle* h = free_;
+				free_         = h->next_hash;
+				return h;
+			}
+
+			void deallocate( lru_handle* h ) {
+				h->next_hash = free_;
+				free_        = h;
+			}
+
+		private:
+			static constexpr int kHandlesPerSlab = 64;
+
+			void grow() {
+				lru_handle* slab = new lru_handle[ kHandlesPerSlab ];
+				slabs_.push_back( slab );
+				for ( int i = 0; i < kHandlesPerSlab; i++ ) {
+					deallocate( &slab[ i ] );
+				}
+			}
+
+			lru_handle*                 free_;
+			core::vector< lru_handle* > slabs_;
 		};
 
 		// We provide our own simple hash table since it removes a whole bunch
@@ -151,6 +281,82 @@ namespace simple_leveldb {
 			}
 		};
 
+		// Count-min sketch of recent access frequencies, the estimator behind
+		// TinyLFU admission.  Four rows of 4-bit counters (kept in bytes for
+		// simplicity), each indexed by a different mix of the key hash; the
+		// estimate is the smallest of the four.  After sample_size_ increments
+		// every counter is halved, so the sketch tracks recent popularity
+		// rather than all-time counts.
+		//
+		// Not thread-safe; the owning shard's mutex serializes all calls.
+		class frequency_sketch {
+		public:
+			frequency_sketch()
+					: mask_( 0 )
+					, sample_size_( 0 )
+					, additions_( 0 ) {}
+
+			bool enabled() const { return !table_.empty(); }
+
+			// Size the sketch for about "expected_entries" distinct hot keys.
+			void initialize( size_t expected_entries ) {
+				size_t width = 64;
+				while ( width < expected_entries && width < ( size_t{ 1 } << 24 ) ) {
+					width *= 2;
+				}
+				table_.assign( kDepth * width, 0 );
+				mask_        = static_cast< uint32_t >( width - 1 );
+				sample_size_ = 10 * width;
+				additions_   = 0;
+			}
+
+			void increment( uint32_t hash ) {
+				for ( int i = 0; i < kDepth; i++ ) {
+					uint8_t& counter = table_[ index( i, hash ) ];
+					if ( counter < kMaxCount ) {
+						counter++;
+					}
+				}
+				if ( ++additions_ >= sample_size_ ) {
+					age();
+				}
+			}
+
+			uint32_t estimate( uint32_t hash ) const {
+				uint32_t result = kMaxCount;
+				for ( int i = 0; i < kDepth; i++ ) {
+					const uint32_t counter = table_[ index( i, hash ) ];
+					if ( counter < result ) {
+						result = counter;
+					}
+				}
+				return result;
+			}
+
+		private:
+			static constexpr int     kDepth    = 4;
+			static constexpr uint8_t kMaxCount = 15;
+
+			size_t index( int row, uint32_t hash ) const {
+				static constexpr uint32_t kSeeds[ kDepth ] = { 0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f };
+				uint32_t                  h                = hash * kSeeds[ row ];
+				h ^= h >> 15;
+				return row * ( size_t{ mask_ } + 1 ) + ( h & mask_ );
+			}
+
+			void age() {
+				for ( uint8_t& counter: table_ ) {
+					counter >>= 1;
+				}
+				additions_ /= 2;
+			}
+
+			core::vector< uint8_t > table_;
+			uint32_t                mask_;
+			size_t                  sample_size_;
+			size_t                  additions_;
+		};
+
 		// A single shard of sharded cache.
 		class lru_cache {
 		public:
@@ -158,11 +364,26 @@ namespace simple_leveldb {
 			~lru_cache();
 
 			// Separate from constructor so caller can easily make an array of LRUcache
-			void set_capacity( size_t capacity ) { capacity_ = capacity; }
+			void set_capacity( size_t capacity, double high_pri_pool_ratio ) {
+				capacity_               = capacity;
+				high_pri_pool_ratio_    = high_pri_pool_ratio;
+				high_pri_pool_capacity_ = static_cast< size_t >( capacity * high_pri_pool_ratio );
+			}
+
+			// Only admit an entry that would evict others if it has been
+			// accessed more often than the LRU victim.  "expected_entries"
+			// sizes the frequency sketch.
+			void enable_admission( size_t expected_entries ) {
+				MutexLock l( &mutex_ );
+				sketch_.initialize( expected_entries );
+			}
 
-			// Like cache methods, but with an extra "hash" parameter.
+			// Like cache methods, but with an extra "hash" parameter.  A
+			// "reservation" is never refused by admission, and is not returned
+			// unless the cache kept it.
 			cache::handle* insert( const slice& key, uint32_t hash, void* value, size_t charge,
-														 core::function< void( const slice&, void* ) > deleter );
+														 cache::deleter_type deleter, cache::priority priority,
+														 bool reservation = false );
 			cache::handle* look_up( const slice& key, uint32_t hash );
 			void           release( cache::handle* handle );
 			void           erase( const slice& key, uint32_t hash );
@@ -171,39 +392,63 @@ namespace simple_leveldb {
         MutexLock l( &mutex_ );
         return usage_;
 			}
+			void get_stats( cache::stats* stats ) const;
 
 		private:
 			void lru_remove( lru_handle* e );
 			void lru_append( lru_handle* list, lru_handle* e );
+			void lru_insert( lru_handle* e );
+			void maintain_pool_size();
+			bool admit( uint32_t hash, size_t charge );
 			void ref( lru_handle* e );
 			void un_ref( lru_handle* e );
 			bool finish_erase( lru_handle* e );
 
 			// Initialized before use.
 			size_t capacity_;
+			double high_pri_pool_ratio_;
+			size_t high_pri_pool_capacity_;
 
 			// mutex_ protects the following state.
 			mutable port::mutex mutex_;
 			size_t usage_       GUARDED_BY( mutex_ );
 
+			// Total charge of the entries in the high-priority pool.
+			size_t high_pri_pool_usage_ GUARDED_BY( mutex_ );
+
 			// Dummy head of LRU list.
 			// lru.prev is newest entry, lru.next is oldest entry.
 			// Entries have refs==1 and in_cache==true.
 			lru_handle lru_ GUARDED_BY( mutex_ );
 
+			// Newest entry of the low-priority pool, or &lru_ if that pool is empty.
+			lru_handle* lru_low_pri_ GUARDED_BY( mutex_ );
+
 			// Dummy head of in-use list.
 			// Entries are in use by clients, and have refs >= 2 and in_cache==true.
 			lru_handle in_use_ GUARDED_BY( mutex_ );
 
 			handle_table table_ GUARDED_BY( mutex_ );
+
+			handle_pool pool_ GUARDED_BY( mutex_ );
+
+			// Access frequencies for admission; disabled unless enable_admission().
+			frequency_sketch sketch_ GUARDED_BY( mutex_ );
+
+			// Counters; usage and pinned_usage are filled in by get_stats().
+			cache::stats stats_ GUARDED_BY( mutex_ );
 		};
 
 		lru_cache::lru_cache()
 				: capacity_( 0 )
-				, usage_( 0 ) {
+				, high_pri_pool_ratio_( 0 )
+				, high_pri_pool_capacity_( 0 )
+				, usage_( 0 )
+				, high_pri_pool_usage_( 0 ) {
 			// Make empty circular linked lists.
 			lru_.next    = &lru_;
 			lru_.prev    = &lru_;
+			lru_low_pri_ = &lru_;
 			in_use_.next = &in_use_;
 			in_use_.prev = &in_use_;
 		}
@@ -234,17 +479,27 @@ namespace simple_leveldb {
 			if ( e->refs == 0 ) {// Deallocate.
 				assert( !e->in_cache );
 				e->deleter( e->key(), e->value );
-				free( e );
+				e->free_key();
+				pool_.deallocate( e );
 			} else if ( e->in_cache && e->refs == 1 ) {
 				// No longer in use; move to lru_ list.
 				lru_remove( e );
-				lru_append( &lru_, e );
+				lru_insert( e );
 			}
 		}
 
+		// Unlink "e" from whichever list it is on.
 		void lru_cache::lru_remove( lru_handle* e ) {
+			if ( lru_low_pri_ == e ) {
+				lru_low_pri_ = e->prev;
+			}
 			e->next->prev = e->prev;
 			e->prev->next = e->next;
+			if ( e->in_high_pri_pool ) {
+				assert( high_pri_pool_usage_ >= e->charge );
+				high_pri_pool_usage_ -= e->charge;
+				e->in_high_pri_pool   = false;
+			}
 		}
 
 		void lru_cache::lru_append( lru_handle* list, lru_handle* e ) {
@@ -255,11 +510,44 @@ namespace simple_leveldb {
 			e->next->prev = e;
 		}
 
+		// Put an unreferenced entry on lru_ in the pool its priority and
+		// history call for.
+		void lru_cache::lru_insert( lru_handle* e ) {
+			if ( high_pri_pool_ratio_ > 0 && ( e->is_high_pri || e->has_hit ) ) {
+				lru_append( &lru_, e );
+				e->in_high_pri_pool   = true;
+				high_pri_pool_usage_ += e->charge;
+				maintain_pool_size();
+			} else {
+				// Midpoint insertion: newest entry of the low-priority pool.
+				lru_append( lru_low_pri_->next, e );
+				lru_low_pri_ = e;
+			}
+		}
+
+		// Demote the oldest high-priority entries until the pool fits again.
+		void lru_cache::maintain_pool_size() {
+			while ( high_pri_pool_usage_ > high_pri_pool_capacity_ ) {
+				lru_low_pri_ = lru_low_pri_->next;
+				assert( lru_low_pri_ != &lru_ );
+				assert( lru_low_pri_->in_high_pri_pool );
+				lru_low_pri_->in_high_pri_pool = false;
+				high_pri_pool_usage_         -= lru_low_pri_->charge;
+			}
+		}
+
 		cache::handle* lru_cache::look_up( const slice& key, uint32_t hash ) {
 			MutexLock   l( &mutex_ );
 			lru_handle* e = table_.look_up( key, hash );
+			if ( sketch_.enabled() ) {
+				sketch_.increment( hash );
+			}
 			if ( e != nullptr ) {
 				ref( e );
+				e->has_hit = true;
+				stats_.hits++;
+			} else {
+				stats_.misses++;
 			}
 			return reinterpret_cast< cache::handle* >( e );
 		}
@@ -269,30 +557,49 @@ namespace simple_leveldb {
 			un_ref( reinterpret_cast< lru_handle* >( handle ) );
 		}
 
+		// TinyLFU admission: a new entry that does not fit may only push out
+		// the LRU victim if the sketch has seen it more often.  Replacing an
+		// existing key, or filling spare capacity, is always allowed.
+		bool lru_cache::admit( uint32_t hash, size_t charge ) {
+			if ( !sketch_.enabled() || usage_ + charge <= capacity_ || lru_.next == &lru_ ) {
+				return true;
+			}
+			return sketch_.estimate( hash ) > sketch_.estimate( lru_.next->hash );
+		}
+
 		cache::handle* lru_cache::insert( const slice& key, uint32_t hash, void* value, size_t charge,
-																			core::function< void( const slice&, void* ) > deleter ) {
+																			cache::deleter_type deleter, cache::priority priority,
+																			bool reservation ) {
 			MutexLock l( &mutex_ );
 
-			lru_handle* e =
-				reinterpret_cast< lru_handle* >( malloc( sizeof( lru_handle ) - 1 + key.size() ) );
-			e->value      = value;
-			e->deleter    = deleter;
-			e->charge     = charge;
-			e->key_length = key.size();
-			e->hash       = hash;
-			e->in_cache   = false;
-			e->refs       = 1;// for the returned handle.
-			std::memcpy( e->key_data, key.data(), key.size() );
-
-			if ( capacity_ > 0 ) {
+			lru_handle* e       = pool_.allocate();
+			e->value            = value;
+			e->deleter          = deleter;
+			e->charge           = charge;
+			e->hash             = hash;
+			e->in_cache         = false;
+			e->is_high_pri      = ( priority == cache::priority::kHigh );
+			e->has_hit          = false;
+			e->in_high_pri_pool = false;
+			e->refs             = 1;// for the returned handle.
+			e->set_key( key );
+
+			if ( capacity_ > 0 &&
+					 ( reservation || table_.look_up( key, hash ) != nullptr || admit( hash, charge ) ) ) {
 				e->refs++;// for the cache's reference.
 				e->in_cache = true;
 				lru_append( &in_use_, e );
 				usage_ += charge;
 				finish_erase( table_.insert( e ) );
-			} else {// don't cache. (capacity_==0 is supported and turns off caching.)
+				stats_.inserts++;
+			} else {// don't cache. (capacity_==0 turns off caching; admission may refuse too.)
 				// next is read by key() in an assert, so it must be initialized
 				e->next = nullptr;
+				stats_.failed_inserts++;
+				if ( reservation ) {
+					un_ref( e );
+					e = nullptr;
+				}
 			}
 			while ( usage_ > capacity_ && lru_.next != &lru_ ) {
 				lru_handle* old = lru_.next;
@@ -301,6 +608,7 @@ namespace simple_leveldb {
 				if ( !erased ) {// to avoid unused variable when compiled NDEBUG
 					assert( erased );
 				}
+				stats_.evictions++;
 			}
 
 			return reinterpret_cast< cache::handle* >( e );
@@ -336,6 +644,18 @@ namespace simple_leveldb {
 			}
 		}
 
+		void lru_cache::get_stats( cache::stats* stats ) const {
+			MutexLock l( &mutex_ );
+			*stats              = stats_;
+			stats->usage        = usage_;
+			stats->pinned_usage = 0;
+			for ( const lru_handle* e = in_use_.next; e != &in_use_; e = e->next ) {
+				stats->pinned_usage += e->charge;
+			}
+		}
+
+		static void delete_reservation( const slice&, void* ) {}
+
 		static const int kNumShardBits = 4;
 		static const int kNumShards    = 1 << kNumShardBits;
 
@@ -352,18 +672,27 @@ namespace simple_leveldb {
 			static uint32_t Shard( uint32_t hash ) { return hash >> ( 32 - kNumShardBits ); }
 
 		public:
-			explicit sharded_lru_cache( size_t capacity )
+			sharded_lru_cache( size_t capacity, double high_pri_pool_ratio, bool tiny_lfu )
 					: last_id_( 0 ) {
 				const size_t per_shard = ( capacity + ( kNumShards - 1 ) ) / kNumShards;
 				for ( int s = 0; s < kNumShards; s++ ) {
-					shard_[ s ].set_capacity( per_shard );
+					shard_[ s ].set_capacity( per_shard, high_pri_pool_ratio );
+					if ( tiny_lfu ) {
+						// Size the sketch as if entries were typical 4KB blocks.
+						shard_[ s ].enable_admission( per_shard / 4096 );
+					}
 				}
 			}
 			~sharded_lru_cache() override {}
-			handle* insert( const slice& key, void* value, size_t charge,
-											core::function< void( const slice&, void* ) > deleter ) override {
+			handle* insert( const slice& key, void* value, size_t charge, deleter_type deleter,
+											priority priority = priority::kLow ) override {
+				const uint32_t hash = Hashslice( key );
+				return shard_[ Shard( hash ) ].insert( key, hash, value, charge, deleter, priority );
+			}
+			handle* insert_reservation( const slice& key, size_t charge ) override {
 				const uint32_t hash = Hashslice( key );
-				return shard_[ Shard( hash ) ].insert( key, hash, value, charge, deleter );
+				return shard_[ Shard( hash ) ].insert( key, hash, nullptr, charge, &delete_reservation,
+																							 priority::kHigh, true );
 			}
 			handle* look_up( const slice& key ) override {
 				const uint32_t hash = Hashslice( key );
@@ -396,10 +725,30 @@ namespace simple_leveldb {
 				}
 				return total;
 			}
+			int  shard_count() const override { return kNumShards; }
+			void get_shard_stats( int shard, stats* stats ) const override {
+				shard_[ shard ].get_stats( stats );
+			}
 		};
 
 	}// end anonymous namespace
 
-	cache* new_lru_cache( size_t capacity ) { return new sharded_lru_cache( capacity ); }
+	static double clip_ratio( double ratio ) {
+		if ( ratio < 0.0 ) {
+			return 0.0;
+		}
+		if ( ratio > 1.0 ) {
+			return 1.0;
+		}
+		return ratio;
+	}
+
+	cache* new_lru_cache( size_t capacity, double high_pri_pool_ratio ) {
+		return new sharded_lru_cache( capacity, clip_ratio( high_pri_pool_ratio ), false );
+	}
+
+	cache* new_tiny_lfu_cache( size_t capacity, double high_pri_pool_ratio ) {
+		return new sharded_lru_cache( capacity, clip_ratio( high_pri_pool_ratio ), true );
+	}
 
 }// namespace simple_leveldb
@@ -0,0 +1,517 @@
+#include "leveldb/cache.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "leveldb/slice.h"
+#include "port/thread_annotations.h"
+#include "util/hash.h"
+#include "util/mutex_lock.h"
+
+namespace simple_leveldb {
+
+	namespace {
+
+		// CLOCK cache implementation
+		//
+		// Each shard is a fixed size open-addressed table of clock_handle slots,
+		// probed linearly from hash & mask.  A slot's "meta" word packs its state
+		// (top two bits) and the number of external references (the rest):
+		//
+		//   kEmpty         slot is free
+		//   kConstruction  slot is owned exclusively by one thread, which is
+		//                  filling or tearing it down
+		//   kVisible       slot holds an entry that look_up() can find
+		//   kInvisible     entry was erased or displaced but is still referenced;
+		//                  the last release() frees it
+		//
+		// look_up() and release() never lock.  look_up() takes a reference with
+		// a fetch_add and only then checks the state and key; a reference on a
+		// slot that turned out not to match is dropped again.  Such transient
+		// references are why state changes that can race with look_up() are
+		// made with fetch_add/CAS that preserve the reference bits.
+		//
+		// insert(), erase(), prune() and the bookkeeping after an entry is freed
+		// are serialized by the shard mutex.  Only they move a slot out of
+		// kVisible, so a reader holding a reference to a kVisible slot sees a
+		// stable key and value.
+		//
+		// Eviction is CLOCK: a hit sets the slot's countdown to kMaxCountdown and
+		// the hand decrements it; an unreferenced slot whose countdown reached
+		// zero is evicted.
+		//
+		// Every slot also counts the entries that probed past it on insertion
+		// ("displacements").  A look_up() that reaches a non-matching slot with
+		// no displacements can stop: nothing further along belongs to its key.
+		struct clock_handle {
+			static constexpr int      kStateShift    = 62;
+			static constexpr uint64_t kRefsMask      = ( uint64_t{ 1 } << kStateShift ) - 1;
+			static constexpr uint64_t kEmpty         = 0;
+			static constexpr uint64_t kConstruction  = 1;
+			static constexpr uint64_t kVisible       = 2;
+			static constexpr uint64_t kInvisible     = 3;
+			static constexpr uint64_t kOneState      = uint64_t{ 1 } << kStateShift;
+			static constexpr uint8_t  kMaxCountdown  = 3;
+			static constexpr uint8_t  kInitCountdown = 1;
+
+			core::atomic< uint64_t > meta{ 0 };
+			core::atomic< uint32_t > displacements{ 0 };
+			core::atomic< uint8_t >  countdown{ 0 };
+			bool                     detached = false;// Not in any table (see insert())
+
+			static constexpr size_t kInlineKeySize = 24;
+
+			uint32_t            hash       = 0;
+			void*               value      = nullptr;
+			cache::deleter_type deleter    = nullptr;
+			size_t              charge     = 0;
+			char*               key_data   = nullptr;// key_inline or a malloc'ed copy of a long key
+			size_t              key_length = 0;
+			char                key_inline[ kInlineKeySize ];
+
+			static uint64_t state_of( uint64_t meta ) { return meta >> kStateShift; }
+			static uint64_t refs_of( uint64_t meta ) { return meta & kRefsMask; }
+
+			slice key() const { return slice( key_data, key_length ); }
+
+			void set_key( const slice& key ) {
+				key_length = key.size();
+				key_data   = key.size() <= kInlineKeySize ? key_inline
+																									: reinterpret_cast< char* >( ::malloc( key.size() ) );
+				std::memcpy( key_data, key.data(), key.size() );
+			}
+
+			// Call the deleter and drop the key.  REQUIRES: kConstruction
+			void free_entry() {
+				deleter( key(), value );
+				deleter = nullptr;
+				if ( key_data != key_inline ) {
+					::free( key_data );
+				}
+				key_data = nullptr;
+				value    = nullptr;
+			}
+		};
+
+		// A single shard of sharded_clock_cache.
+		class clock_cache {
+		public:
+			clock_cache();
+			~clock_cache();
+
+			// Separate from constructor so caller can easily make an array.
+			void set_capacity( size_t capacity, size_t estimated_entry_charge );
+
+			cache::handle* insert( const slice& key, uint32_t hash, void* value, size_t charge,
+														 cache::deleter_type deleter );
+			cache::handle* look_up( const slice& key, uint32_t hash );
+			void           release( cache::handle* handle );
+			void           erase( const slice& key, uint32_t hash );
+			void           prune();
+			size_t         total_charge() const { return usage_.load( core::memory_order_relaxed ); }
+			void           get_stats( cache::stats* stats ) const;
+
+		private:
+			static constexpr double kLoadFactor = 0.7;
+
+			uint32_t home( uint32_t hash ) const { return hash & mask_; }
+
+			// REQUIRES: mutex_ held
+			clock_handle* find_visible( const slice& key, uint32_t hash );
+			bool          evict_until( size_t charge );
+			clock_handle* claim_slot( uint32_t hash );
+			void          make_invisible( clock_handle* h );
+			void          recycle( clock_handle* h );
+			void          try_free( clock_handle* h );
+
+			// Initialized before use.
+			size_t        capacity_;
+			clock_handle* slots_;
+			uint32_t      length_;
+			uint32_t      mask_;
+			uint32_t      occupancy_limit_;
+
+			core::atomic< size_t > usage_;
+
+			// Counted by look_up(), which takes no lock.
+			core::atomic< uint64_t > hits_;
+			core::atomic< uint64_t > misses_;
+
+			// mutex_ serializes every change that takes a slot out of kVisible
+			// or kEmpty, and protects the following state.
+			mutable port::mutex mutex_;
+			uint32_t            occupancy_ GUARDED_BY( mutex_ );
+			uint32_t            clock_hand_ GUARDED_BY( mutex_ );
+			uint64_t            inserts_ GUARDED_BY( mutex_ );
+			uint64_t            evictions_ GUARDED_BY( mutex_ );
+			uint64_t            failed_inserts_ GUARDED_BY( mutex_ );
+		};
+
+		clock_cache::clock_cache()
+				: capacity_( 0 )
+				, slots_( nullptr )
+				, length_( 0 )
+				, mask_( 0 )
+				, occupancy_limit_( 0 )
+				, usage_( 0 )
+				, hits_( 0 )
+				, misses_( 0 )
+				, occupancy_( 0 )
+				, clock_hand_( 0 )
+				, inserts_( 0 )
+				, evictions_( 0 )
+				, failed_inserts_( 0 ) {}
+
+		clock_cache::~clock_cache() {
+			for ( uint32_t i = 0; i < length_; i++ ) {
+				clock_handle*  h = &slots_[ i ];
+				const uint64_t m = h->meta.load( core::memory_order_relaxed );
+				// Error if caller has an unreleased handle
+				assert( clock_handle::refs_of( m ) == 0 );
+				if ( clock_handle::state_of( m ) == clock_handle::kVisible ) {
+					h->free_entry();
+				}
+			}
+			delete[] slots_;
+		}
+
+		void clock_cache::set_capacity( size_t capacity, size_t estimated_entry_charge ) {
+			capacity_ = capacity;
+
+			const double entries = static_cast< double >( capacity ) /
+														 static_cast< double >( estimated_entry_charge == 0 ? 1 : estimated_entry_charge );
+			uint32_t length = 16;
+			while ( length < ( 1u << 30 ) && length * kLoadFactor < entries ) {
+				length *= 2;
+			}
+			delete[] slots_;
+			slots_           = new clock_handle[ length ];
+			length_          = length;
+			mask_            = length - 1;
+			occupancy_limit_ = static_cast< uint32_t >( length * kLoadFactor );
+		}
+
+		cache::handle* clock_cache::look_up( const slice& key, uint32_t hash ) {
+			uint32_t index = home( hash );
+			for ( uint32_t probes = 0; probes < length_; probes++ ) {
+				clock_handle* h = &slots_[ index ];
+				if ( clock_handle::state_of( h->meta.load( core::memory_order_acquire ) ) ==
+						 clock_handle::kVisible ) {
+					// Take a reference first; only then are the key and the state
+					// guaranteed not to change under us.
+					const uint64_t old = h->meta.fetch_add( 1, core::memory_order_acq_rel );
+					if ( clock_handle::state_of( old ) == clock_handle::kVisible && h->hash == hash &&
+							 h->key() == key ) {
+						h->countdown.store( clock_handle::kMaxCountdown, core::memory_order_relaxed );
+						hits_.fetch_add( 1, core::memory_order_relaxed );
+						return reinterpret_cast< cache::handle* >( h );
+					}
+					release( reinterpret_cast< cache::handle* >( h ) );
+				}
+				if ( h->displacements.load( core::memory_order_acquire ) == 0 ) {
+					break;
+				}
+				index = ( index + 1 ) & mask_;
+			}
+			misses_.fetch_add( 1, core::memory_order_relaxed );
+			return nullptr;
+		}
+
+		void clock_cache::release( cache::handle* handle ) {
+			clock_handle*  h   = reinterpret_cast< clock_handle* >( handle );
+			const uint64_t old = h->meta.fetch_sub( 1, core::memory_order_acq_rel );
+			assert( clock_handle::refs_of( old ) > 0 );
+			if ( clock_handle::state_of( old ) == clock_handle::kInvisible &&
+					 clock_handle::refs_of( old ) == 1 ) {
+				try_free( h );
+			}
+		}
+
+		// Free an invisible entry if nobody references it.  Races with transient
+		// references from look_up() are settled by the CAS: exactly one thread
+		// moves the slot to kConstruction.
+		void clock_cache::try_free( clock_handle* h ) {
+			uint64_t expected = clock_handle::kInvisible << clock_handle::kStateShift;
+			if ( !h->meta.compare_exchange_strong( expected,
+																						 clock_handle::kConstruction << clock_handle::kStateShift,
+																						 core::memory_order_acq_rel ) ) {
+				return;
+			}
+			h->free_entry();
+			if ( h->detached ) {
+				delete h;
+				return;
+			}
+			MutexLock l( &mutex_ );
+			recycle( h );
+		}
+
+		// Return a slot owned by us in kConstruction to kEmpty and undo the
+		// displacements its entry caused.
+		void clock_cache::recycle( clock_handle* h ) {
+			const uint32_t target = static_cast< uint32_t >( h - slots_ );
+			for ( uint32_t index = home( h->hash ); index != target; index = ( index + 1 ) & mask_ ) {
+				slots_[ index ].displacements.fetch_sub( 1, core::memory_order_relaxed );
+			}
+			usage_.fetch_sub( h->charge, core::memory_order_relaxed );
+			h->charge = 0;
+			occupancy_--;
+			h->meta.fetch_sub( clock_handle::kOneState, core::memory_order_release );
+		}
+
+		clock_handle* clock_cache::find_visible( const slice& key, uint32_t hash ) {
+			uint32_t index = home( hash );
+			for ( uint32_t probes = 0; probes < length_; probes++ ) {
+				clock_handle* h = &slots_[ index ];
+				if ( clock_handle::state_of( h->meta.load( core::memory_order_acquire ) ) ==
+							 clock_handle::kVisible &&
+						 h->hash == hash && h->key() == key ) {
+					return h;
+				}
+				if ( h->displacements.load( core::memory_order_relaxed ) == 0 ) {
+					break;
+				}
+				index = ( index + 1 ) & mask_;
+			}
+			return nullptr;
+		}
+
+		// Take "h" out of the table.  It is freed now if unreferenced, else by
+		// the last release().
+		void clock_cache::make_invisible( clock_handle* h ) {
+			const uint64_t old = h->meta.fetch_add( clock_handle::kOneState, core::memory_order_acq_rel );
+			assert( clock_handle::state_of( old ) == clock_handle::kVisible );
+			if ( clock_handle::refs_of( old ) == 0 ) {
+				uint64_t expected = clock_handle::kInvisible << clock_handle::kStateShift;
+				if ( h->meta.compare_exchange_strong( expected,
+																							clock_handle::kConstruction << clock_handle::kStateShift,
+																							core::memory_order_acq_rel ) ) {
+					h->free_entry();
+					recycle( h );
+				}
+			}
+		}
+
+		// Run the clock until "charge" more bytes fit and a slot is free.
+		// Returns false if that is impossible because every entry is in use.
+		bool clock_cache::evict_until( size_t charge ) {
+			// Two full sweeps take any countdown from kMaxCountdown to zero; one
+			// more finds the entries that reached zero.
+			const uint32_t max_steps = length_ * ( clock_handle::kMaxCountdown + 1 );
+			for ( uint32_t step = 0; step < max_steps; step++ ) {
+				if ( usage_.load( core::memory_order_relaxed ) + charge <= capacity_ &&
+						 occupancy_ < occupancy_limit_ ) {
+					return true;
+				}
+				clock_handle* h = &slots_[ clock_hand_ ];
+				clock_hand_     = ( clock_hand_ + 1 ) & mask_;
+
+				uint64_t expected = clock_handle::kVisible << clock_handle::kStateShift;
+				if ( h->meta.load( core::memory_order_relaxed ) != expected ) {
+					continue;// Empty, in use or being torn down
+				}
+				const uint8_t countdown = h->countdown.load( core::memory_order_relaxed );
+				if ( countdown > 0 ) {
+					h->countdown.store( countdown - 1, core::memory_order_relaxed );
+					continue;
+				}
+				if ( h->meta.compare_exchange_strong( expected,
+																							clock_handle::kConstruction << clock_handle::kStateShift,
+																							core::memory_order_acq_rel ) ) {
+					h->free_entry();
+					recycle( h );
+					evictions_++;
+				}
+			}
+			return occupancy_ < occupancy_limit_;
+		}
+
+		// Find and own (kConstruction) a free slot for "hash".
+		clock_handle* clock_cache::claim_slot( uint32_t hash ) {
+			uint32_t index = home( hash );
+			for ( uint32_t probes = 0; probes < length_; probes++ ) {
+				clock_handle* h = &slots_[ index ];
+				uint64_t      m = h->meta.load( core::memory_order_relaxed );
+				while ( clock_handle::state_of( m ) == clock_handle::kEmpty ) {
+					if ( h->meta.compare_exchange_weak( m, m + clock_handle::kOneState,
+																							core::memory_order_acq_rel ) ) {
+						// Account for the probe sequence that led here.
+						for ( uint32_t i = home( hash ); i != index; i = ( i + 1 ) & mask_ ) {
+							slots_[ i ].displacements.fetch_add( 1, core::memory_order_relaxed );
+						}
+						occupancy_++;
+						return h;
+					}
+				}
+				index = ( index + 1 ) & mask_;
+			}
+			return nullptr;
+		}
+
+		cache::handle* clock_cache::insert( const slice& key, uint32_t hash, void* value, size_t charge,
+																				cache::deleter_type deleter ) {
+			MutexLock l( &mutex_ );
+
+			clock_handle* old = find_visible( key, hash );
+			if ( old != nullptr ) {
+				make_invisible( old );
+			}
+
+			clock_handle* h = nullptr;
+			if ( capacity_ > 0 && evict_until( charge ) ) {
+				h = claim_slot( hash );
+			}
+			if ( h == nullptr ) {
+				// Don't cache: capacity_ == 0, or every slot is pinned.  Hand out a
+				// handle that is freed by its release().
+				h           = new clock_handle;
+				h->detached = true;
+				failed_inserts_++;
+			} else {
+				inserts_++;
+			}
+
+			h->hash    = hash;
+			h->value   = value;
+			h->deleter = deleter;
+			h->set_key( key );
+
+			if ( h->detached ) {
+				h->meta.store( ( clock_handle::kInvisible << clock_handle::kStateShift ) | 1,
+											 core::memory_order_release );
+			} else {
+				h->charge = charge;
+				usage_.fetch_add( charge, core::memory_order_relaxed );
+				h->countdown.store( clock_handle::kInitCountdown, core::memory_order_relaxed );
+				// kConstruction -> kVisible, plus the reference being returned.
+				h->meta.fetch_add( clock_handle::kOneState + 1, core::memory_order_release );
+			}
+			return reinterpret_cast< cache::handle* >( h );
+		}
+
+		void clock_cache::erase( const slice& key, uint32_t hash ) {
+			MutexLock     l( &mutex_ );
+			clock_handle* h = find_visible( key, hash );
+			if ( h != nullptr ) {
+				make_invisible( h );
+			}
+		}
+
+		void clock_cache::prune() {
+			MutexLock l( &mutex_ );
+			for ( uint32_t i = 0; i < length_; i++ ) {
+				clock_handle* h        = &slots_[ i ];
+				uint64_t      expected = clock_handle::kVisible << clock_handle::kStateShift;
+				if ( h->meta.compare_exchange_strong( expected,
+																							clock_handle::kConstruction << clock_handle::kStateShift,
+																							core::memory_order_acq_rel ) ) {
+					h->free_entry();
+					recycle( h );
+				}
+			}
+		}
+
+		void clock_cache::get_stats( cache::stats* stats ) const {
+			MutexLock l( &mutex_ );
+			*stats                = cache::stats();
+			stats->hits           = hits_.load( core::memory_order_relaxed );
+			stats->misses         = misses_.load( core::memory_order_relaxed );
+			stats->inserts        = inserts_;
+			stats->evictions      = evictions_;
+			stats->failed_inserts = failed_inserts_;
+			stats->usage          = usage_.load( core::memory_order_relaxed );
+			for ( uint32_t i = 0; i < length_; i++ ) {
+				const uint64_t m = slots_[ i ].meta.load( core::memory_order_relaxed );
+				if ( clock_handle::state_of( m ) == clock_handle::kVisible && clock_handle::refs_of( m ) > 0 ) {
+					stats->pinned_usage += slots_[ i ].charge;
+				}
+			}
+		}
+
+		static void delete_reservation( const slice&, void* ) {}
+
+		static const int kNumShardBits = 4;
+		static const int kNumShards    = 1 << kNumShardBits;
+
+		class sharded_clock_cache : public cache {
+		private:
+			clock_cache             shard_[ kNumShards ];
+			core::atomic< uint64_t > last_id_;
+
+			static inline uint32_t hash_slice( const slice& s ) {
+				return Hash( s.data(), s.size(), 0 );
+			}
+
+			static uint32_t shard( uint32_t hash ) { return hash >> ( 32 - kNumShardBits ); }
+
+		public:
+			sharded_clock_cache( size_t capacity, size_t estimated_entry_charge )
+					: last_id_( 0 ) {
+				const size_t per_shard = ( capacity + ( kNumShards - 1 ) ) / kNumShards;
+				for ( int s = 0; s < kNumShards; s++ ) {
+					shard_[ s ].set_capacity( per_shard, estimated_entry_charge );
+				}
+			}
+			~sharded_clock_cache() override {}
+			handle* insert( const slice& key, void* value, size_t charge, deleter_type deleter,
+											priority = priority::kLow ) override {
+				const uint32_t hash = hash_slice( key );
+				return shard_[ shard( hash ) ].insert( key, hash, value, charge, deleter );
+			}
+			handle* insert_reservation( const slice& key, size_t charge ) override {
+				const uint32_t hash = hash_slice( key );
+				clock_cache&   s    = shard_[ shard( hash ) ];
+				clock_handle*  h    = reinterpret_cast< clock_handle* >(
+					s.insert( key, hash, nullptr, charge, &delete_reservation ) );
+				if ( h->detached ) {
+					// Every slot is pinned; the handle charges nothing.
+					s.release( reinterpret_cast< handle* >( h ) );
+					return nullptr;
+				}
+				return reinterpret_cast< handle* >( h );
+			}
+			handle* look_up( const slice& key ) override {
+				const uint32_t hash = hash_slice( key );
+				return shard_[ shard( hash ) ].look_up( key, hash );
+			}
+			void release( handle* handle ) override {
+				clock_handle* h = reinterpret_cast< clock_handle* >( handle );
+				shard_[ shard( h->hash ) ].release( handle );
+			}
+			void erase( const slice& key ) override {
+				const uint32_t hash = hash_slice( key );
+				shard_[ shard( hash ) ].erase( key, hash );
+			}
+			void* value( handle* handle ) override {
+				return reinterpret_cast< clock_handle* >( handle )->value;
+			}
+			uint64_t new_id() override { return last_id_.fetch_add( 1, core::memory_order_relaxed ) + 1; }
+			void     prune() override {
+				for ( int s = 0; s < kNumShards; s++ ) {
+					shard_[ s ].prune();
+				}
+			}
+			size_t total_charge() const override {
+				size_t total = 0;
+				for ( int s = 0; s < kNumShards; s++ ) {
+					total += shard_[ s ].total_charge();
+				}
+				return total;
+			}
+			int  shard_count() const override { return kNumShards; }
+			void get_shard_stats( int shard, stats* stats ) const override {
+				shard_[ shard ].get_stats( stats );
+			}
+		};
+
+	}// end anonymous namespace
+
+	cache* new_clock_cache( size_t capacity, size_t estimated_entry_charge ) {
+		return new sharded_clock_cache( capacity, estimated_entry_charge );
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,52 @@
+#include "leveldb/compaction_filter.h"
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace simple_leveldb {
+
+	compaction_filter::~compaction_filter() = default;
+
+	namespace {
+
+		static const size_t   kTimestampSize   = 4;
+		static const uint64_t kMicrosPerSecond = 1000000;
+
+		class ttl_compaction_filter : public compaction_filter {
+		private:
+			const uint64_t ttl_seconds_;
+			env* const     env_;
+
+		public:
+			ttl_compaction_filter( uint64_t ttl_seconds, env* env )
+					: ttl_seconds_( ttl_seconds )
+					, env_( env ) {}
+
+			const char* name() const override { return "leveldb.TTLCompactionFilter"; }
+
+			decision filter( const context&, const slice&, const slice& existing_value,
+											 core::string* ) const override {
+				if ( existing_value.size() < kTimestampSize ) {
+					return decision::kKeep;
+				}
+				const uint64_t written = decode_fixed32( existing_value.data() + existing_value.size() - kTimestampSize );
+				const uint64_t now     = env_->now_micros() / kMicrosPerSecond;
+				return written + ttl_seconds_ < now ? decision::kRemove : decision::kKeep;
+			}
+		};
+
+	}// end anonymous namespace
+
+	const compaction_filter* new_ttl_compaction_filter( uint64_t ttl_seconds, env* env ) {
+		return new ttl_compaction_filter( ttl_seconds, env );
+	}
+
+	void append_ttl_timestamp( core::string* value, env* env ) {
+		put_fixed32( value, static_cast< uint32_t >( env->now_micros() / kMicrosPerSecond ) );
+	}
+
+}// namespace simple_leveldb
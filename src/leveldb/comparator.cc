@@ -1,5 +1,10 @@
 #include "leveldb/__detail/no_destructor.h"
 #include "leveldb/comparator.h"
+#include "leveldb/slice.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
 
 namespace simple_leveldb {
 
@@ -14,9 +19,44 @@ namespace simple_leveldb {
 				return "simple_leveldb.bytewise_comparator";
 			}
 
-			int32_t compare( const slice& a, const slice& b ) const override {}
-			void    find_shortest_separator( core::string* start, const slice& limit ) const override {}
-			void    find_short_successor( core::string* key ) const override {}
+			int32_t compare( const slice& a, const slice& b ) const override {
+				return a.compare( b );
+			}
+
+			void find_shortest_separator( core::string* start, const slice& limit ) const override {
+				// Find length of common prefix
+				size_t min_length = core::min( start->size(), limit.size() );
+				size_t diff_index = 0;
+				while ( ( diff_index < min_length ) && ( ( *start )[ diff_index ] == limit[ diff_index ] ) ) {
+					diff_index++;
+				}
+
+				if ( diff_index >= min_length ) {
+					// Do not shorten if one string is a prefix of the other
+				} else {
+					uint8_t diff_byte = static_cast< uint8_t >( ( *start )[ diff_index ] );
+					if ( diff_byte < static_cast< uint8_t >( 0xff ) &&
+							 diff_byte + 1 < static_cast< uint8_t >( limit[ diff_index ] ) ) {
+						( *start )[ diff_index ]++;
+						start->resize( diff_index + 1 );
+						assert( compare( *start, limit ) < 0 );
+					}
+				}
+			}
+
+			void find_short_successor( core::string* key ) const override {
+				// Find first character that can be incremented
+				size_t n = key->size();
+				for ( size_t i = 0; i < n; i++ ) {
+					const uint8_t byte = ( *key )[ i ];
+					if ( byte != static_cast< uint8_t >( 0xff ) ) {
+						( *key )[ i ] = byte + 1;
+						key->resize( i + 1 );
+						return;
+					}
+				}
+				// *key is a run of 0xffs.  Leave it alone.
+			}
 		};
 	}// namespace
 
@@ -7,10 +7,13 @@
 #include "leveldb/__detail/version_edit.h"
 #include "leveldb/__detail/version_set.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/comparator.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
@@ -28,23 +31,29 @@
 
 namespace simple_leveldb {
 
-	struct db_impl::compaction_state {
+	// One key range of a compaction, written to its own output files.
+	struct db_impl::sub_compaction_state {
 		struct output {
-			uint64_t     number;
-			uint64_t     file_size;
-			internal_key smallest, largest;
+			uint64_t         number;
+			uint64_t         file_size;
+			internal_key     smallest, largest;
+			table_properties properties;
 		};
 
-		compaction* const      compaction;
-		sequence_number        smallest_snapshot;
+		const core::string*    start;// First user key, or nullptr for unbounded
+		const core::string*    end;  // User key past the range, or nullptr for unbounded
+		uint64_t               next_file_number;// Reserved for the next output, or 0
+		compaction::cursor     cursor;
 		core::vector< output > outputs;
 		writable_file*         outfile;
 		table_builder*         builder;
 		uint64_t               total_bytes;
+		status                 s;
 
-		explicit compaction_state( class compaction* c )
-				: compaction( c )
-				, smallest_snapshot( 0 )
+		sub_compaction_state()
+				: start( nullptr )
+				, end( nullptr )
+				, next_file_number( 0 )
 				, outfile( nullptr )
 				, builder( nullptr )
 				, total_bytes( 0 ) {}
@@ -52,12 +61,26 @@ namespace simple_leveldb {
 		output* current_output() { return &outputs[ outputs.size() - 1 ]; }
 	};
 
+	struct db_impl::compaction_state {
+		compaction* const                    compaction;
+		sequence_number                      smallest_snapshot;
+		core::vector< core::string >         boundaries;// Between neighbouring subs
+		core::vector< sub_compaction_state > subs;      // In key order
+
+		explicit compaction_state( class compaction* c )
+				: compaction( c )
+				, smallest_snapshot( 0 ) {}
+	};
+
 }// namespace simple_leveldb
 
 namespace simple_leveldb {
 
 	db::~db() = default;
 
+	// Threads db::Open uses to open every table when max_open_files is -1.
+	static const int32_t kNumPreloadThreads = 16;
+
 	status db::Open( const options& options, const core::string& name, db** dbptr ) {
 		*dbptr = nullptr;
 
@@ -77,7 +100,7 @@ namespace simple_leveldb {
 				impl->log_file_       = file;
 				impl->logfile_number_ = new_logger_number;
 				impl->log_            = new log::writer( file );
-				impl->mem_            = new mem_table( impl->internal_comparator_ );
+				impl->mem_            = impl->new_mem_table();
 				impl->mem_->ref();
 			}
 		}
@@ -89,6 +112,17 @@ namespace simple_leveldb {
 		}
 		if ( s.is_ok() ) {
 			impl->RemoveObsoleteFiles();
+		}
+		if ( s.is_ok() && impl->options_.max_open_files == -1 ) {
+			core::vector< file_meta_data* > files;
+			impl->versions_->get_current_files( &files );
+			s = impl->table_cache_->preload( files, kNumPreloadThreads );
+		}
+		if ( s.is_ok() ) {
+			env* env = impl->env_;
+			if ( env->get_background_threads( env::priority::kLow ) < impl->options_.max_background_compactions ) {
+				env->set_background_threads( impl->options_.max_background_compactions, env::priority::kLow );
+			}
 			impl->MaybeScheduleCompaction();
 		}
 		impl->mtx_.unlock();
@@ -110,6 +144,9 @@ namespace simple_leveldb {
 	const int kNumNonTableCacheFiles = 10;
 
 	static int32_t table_cache_size( const options& sanitized_options ) {
+		if ( sanitized_options.max_open_files == -1 ) {
+			return -1;
+		}
 		return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 	}
 
@@ -128,6 +165,10 @@ namespace simple_leveldb {
 			, log_file_( nullptr )
 			, logfile_number_( 0 )
 			, log_( nullptr )
+			, background_flush_scheduled_( false )
+			, background_compactions_scheduled_( 0 )
+			, compaction_blocked_( false )
+			, manual_compaction_( nullptr )
 			, versions_( new version_set( dbname_, &options_, table_cache_, &internal_comparator_ ) ) {}
 
 	db_impl::~db_impl() {}
@@ -153,10 +194,65 @@ namespace simple_leveldb {
 	status db_impl::Write( const write_options& opt, write_batch* batch ) {
 	}
 
+	static void append_cache_stats( core::string* value, const char* name, const cache::stats& stats ) {
+		char buf[ 200 ];
+		core::snprintf( buf, sizeof( buf ), "%-8s %12llu %12llu %10llu %10llu %8llu %12llu %12llu\n", name,
+										static_cast< unsigned long long >( stats.hits ),
+										static_cast< unsigned long long >( stats.misses ),
+										static_cast< unsigned long long >( stats.inserts ),
+										static_cast< unsigned long long >( stats.evictions ),
+										static_cast< unsigned long long >( stats.failed_inserts ),
+										static_cast< unsigned long long >( stats.usage ),
+										static_cast< unsigned long long >( stats.pinned_usage ) );
+		value->append( buf );
+	}
+
+	bool db_impl::GetProperty( const slice& property, core::string* value ) {
+		value->clear();
+
+		slice in     = property;
+		slice prefix( "leveldb." );
+		if ( !in.starts_with( prefix ) ) return false;
+		in.remove_prefix( prefix.size() );
+
+		if ( in == "block-cache-stats" ) {
+			const cache* block_cache = options_.block_cache;
+			if ( block_cache == nullptr ) return false;
+			char buf[ 200 ];
+			core::snprintf( buf, sizeof( buf ), "%-8s %12s %12s %10s %10s %8s %12s %12s\n", "", "hits",
+											"misses", "inserts", "evictions", "failed", "usage", "pinned" );
+			value->append( buf );
+
+			cache::stats stats;
+			block_cache->get_stats( &stats );
+			append_cache_stats( value, "total", stats );
+
+			static const char* const kTypeNames[ cache::kNumBlockTypes ] = { "data", "index", "filter" };
+			for ( int t = 0; t < cache::kNumBlockTypes; t++ ) {
+				block_cache->get_block_stats( static_cast< cache::block_type >( t ), &stats );
+				append_cache_stats( value, kTypeNames[ t ], stats );
+			}
+
+			for ( int s = 0; s < block_cache->shard_count(); s++ ) {
+				block_cache->get_shard_stats( s, &stats );
+				core::snprintf( buf, sizeof( buf ), "shard%d", s );
+				append_cache_stats( value, buf, stats );
+			}
+			return true;
+		}
+
+		return false;
+	}
+
 	const comparator* db_impl::user_comparator() const {
 		return internal_comparator_.user_comparator();
 	}
 
+	mem_table* db_impl::new_mem_table() const {
+		return new mem_table( internal_comparator_,
+													options_.charge_memory_to_block_cache ? options_.block_cache : nullptr );
+	}
+
 	status db_impl::NewDB() {
 		version_edit new_db;
 		new_db.set_comparator_name( user_comparator()->name() );
@@ -400,27 +496,260 @@ namespace simple_leveldb {
 	void db_impl::MaybeScheduleCompaction() {
 		mtx_.assert_held();
 
-		if ( background_compaction_scheduled_ ) {
+		if ( shutting_down_.load( core::memory_order_acquire ) ) {
+			return;
+		}
+		if ( !bg_error_.is_ok() ) {
+			return;
+		}
+
+		if ( static_cast< int32_t >( imm_.size() ) >= options_.min_write_buffer_number_to_merge &&
+				 !background_flush_scheduled_ ) {
+			background_flush_scheduled_ = true;
+			env_->schedule( db_impl::bg_flush_work, this, env::priority::kHigh );
+		}
+
+		const bool manual_pending = ( manual_compaction_ != nullptr && !manual_compaction_->in_progress );
+		if ( background_compactions_scheduled_ >= options_.max_background_compactions ) {
 			// already scheduled
-		} else if ( shutting_down_.load( core::memory_order_acquire ) ) {
+		} else if ( compaction_blocked_ ) {
+			// wait for a running job to finish
+		} else if ( !manual_pending && !versions_->needs_compaction() ) {
 			//
-		} else if ( !bg_error_.is_ok() ) {
+		} else {
+			background_compactions_scheduled_++;
+			env_->schedule( db_impl::bg_work, this, env::priority::kLow );
+		}
+	}
+
+	void db_impl::bg_flush_work( void* db ) {
+		reinterpret_cast< db_impl* >( db )->background_flush_call();
+	}
+
+	void db_impl::background_flush_call() {
+		MutexLock lock( &mtx_ );
+		assert( background_flush_scheduled_ );
+
+		if ( shutting_down_.load( core::memory_order_acquire ) ) {
 			//
-		} else if ( imm_ == nullptr && manual_compaction_ == nullptr && !versions_->needs_compaction() ) {
+		} else if ( !bg_error_.is_ok() ) {
 			//
+		} else if ( !imm_.empty() ) {
+			compact_mem_table();
+			compaction_blocked_ = false;
+		}
+
+		background_flush_scheduled_ = false;
+		MaybeScheduleCompaction();
+		background_work_finished_signal_.signal_all();
+	}
+
+	// Make sure mem_ has room for a write, switching to a fresh memtable
+	// and log if it is full or "force" is set.  Waits while
+	// max_write_buffer_number memtables are held already.
+	// REQUIRES: mutex held
+	status db_impl::make_room_for_write( bool force ) {
+		mtx_.assert_held();
+		status s;
+		while ( true ) {
+			if ( !bg_error_.is_ok() ) {
+				// Yield previous error
+				s = bg_error_;
+				break;
+			} else if ( !force && mem_->approximate_memory_usage() <= options_.write_buffer_size ) {
+				// There is room in current memtable
+				break;
+			} else if ( static_cast< int32_t >( imm_.size() ) + 1 >= options_.max_write_buffer_number ) {
+				// Every memtable is in use; wait for a flush.
+				Log( options_.info_log, "Too many memtables (%d); waiting...\n", static_cast< int >( imm_.size() ) + 1 );
+				background_work_finished_signal_.wait();
+			} else {
+				// Switch to a new memtable and log, and flush the old ones.
+				const uint64_t new_log_number = versions_->new_file_number();
+				writable_file* lfile          = nullptr;
+				s                             = env_->new_writable_file( log_file_name( dbname_, new_log_number ), &lfile );
+				if ( !s.is_ok() ) {
+					break;
+				}
+				delete log_;
+				s = log_file_->close();
+				if ( !s.is_ok() ) {
+					// We may have lost some data written to the previous log file.
+					// Switch to the new log file anyway, but record as a background
+					// error so we do not attempt any more writes.
+					record_background_error( s );
+				}
+				delete log_file_;
+
+				imm_.push_back( immutable_mem_table{ mem_, logfile_number_ } );
+				log_file_       = lfile;
+				logfile_number_ = new_log_number;
+				log_            = new log::writer( lfile );
+				mem_            = new_mem_table();
+				mem_->ref();
+				force = false;// Do not force another switch
+				MaybeScheduleCompaction();
+			}
+		}
+		return s;
+	}
+
+	// Flush every memtable in imm_ into one level-0 table.
+	// REQUIRES: mutex held
+	void db_impl::compact_mem_table() {
+		mtx_.assert_held();
+		assert( !imm_.empty() );
+
+		// Memtables that fill up while we write stay for the next flush.
+		const size_t               n = imm_.size();
+		core::vector< mem_table* > mems;
+		for ( size_t i = 0; i < n; i++ ) {
+			mems.push_back( imm_[ i ].mem );
+		}
+
+		version_edit edit;
+		status       s = write_level0_table( mems, &edit );
+		if ( s.is_ok() && shutting_down_.load( core::memory_order_acquire ) ) {
+			s = status::io_error( "Deleting DB during memtable compaction" );
+		}
+
+		// Logs older than the oldest memtable left are no longer needed.
+		if ( s.is_ok() ) {
+			edit.set_prev_log_number( 0 );
+			edit.set_log_number( n < imm_.size() ? imm_[ n ].log_number : logfile_number_ );
+			s = versions_->log_any_apply( &edit, &mtx_ );
+		}
+
+		if ( s.is_ok() ) {
+			for ( mem_table* mem: mems ) {
+				mem->unref();
+			}
+			imm_.erase( imm_.begin(), imm_.begin() + n );
+			RemoveObsoleteFiles();
 		} else {
-			background_compaction_scheduled_ = true;
-			env_->schedule( db_impl::bg_work, this );
+			record_background_error( s );
 		}
 	}
 
+	// Write the contents of "mems" to a new level-0 table and record it in
+	// "*edit".  Entries hidden by a newer entry for the same user key in
+	// any of them are dropped, as compactions do.
+	// REQUIRES: mutex held
+	status db_impl::write_level0_table( const core::vector< mem_table* >& mems, version_edit* edit ) {
+		mtx_.assert_held();
+		const sequence_number smallest_snapshot = versions_->last_sequence();
+		file_meta_data        meta;
+		meta.number = versions_->new_file_number();
+		pending_outputs_.insert( meta.number );
+		core::vector< iterator* > inputs;
+		for ( mem_table* mem: mems ) {
+			inputs.push_back( mem->new_iterator() );
+		}
+		Log( options_.info_log, "Level-0 table #%llu: started, %d memtables",
+				 static_cast< unsigned long long >( meta.number ), static_cast< int >( mems.size() ) );
+
+		status s;
+		{
+			mtx_.unlock();
+			const core::string fname = table_file_name( dbname_, meta.number );
+			writable_file*     file  = nullptr;
+			s = open_writable_file( env_, fname, options_.use_direct_io_for_flush_and_compaction, &file );
+			if ( s.is_ok() ) {
+				if ( options_.rate_limiter != nullptr ) {
+					file = new_rate_limited_file( file, options_.rate_limiter, env::priority::kHigh );
+				}
+				table_builder*    builder = new table_builder( options_, file );
+				const comparator* ucmp    = user_comparator();
+				for ( iterator* input: inputs ) {
+					input->seek_to_first();
+				}
+
+				// Merge the memtables in internal key order.  There are only a
+				// few, so a linear scan for the smallest head will do.
+				parsed_internal_key ikey;
+				core::string        current_user_key;
+				bool                has_current_user_key  = false;
+				sequence_number     last_sequence_for_key = kMaxSequenceNumber;
+				while ( true ) {
+					iterator* smallest = nullptr;
+					for ( iterator* input: inputs ) {
+						if ( input->valid() &&
+								 ( smallest == nullptr || internal_comparator_.compare( input->key(), smallest->key() ) < 0 ) ) {
+							smallest = input;
+						}
+					}
+					if ( smallest == nullptr ) {
+						break;
+					}
+					const slice key  = smallest->key();
+					bool        drop = false;
+					if ( parse_internal_key( key, &ikey ) ) {
+						if ( !has_current_user_key || ucmp->compare( ikey.user_key, current_user_key ) != 0 ) {
+							current_user_key.assign( ikey.user_key.data(), ikey.user_key.size() );
+							has_current_user_key  = true;
+							last_sequence_for_key = kMaxSequenceNumber;
+						}
+						// Deletions are kept: older values may live in the tables.
+						drop                  = ( last_sequence_for_key <= smallest_snapshot );
+						last_sequence_for_key = ikey.sequence;
+					}
+					if ( !drop ) {
+						if ( builder->num_entries() == 0 ) {
+							meta.smallest.decode_from( key );
+						}
+						meta.largest.decode_from( key );
+						builder->add( key, smallest->value() );
+					}
+					smallest->next();
+				}
+
+				if ( builder->num_entries() > 0 ) {
+					s = builder->finish();
+					if ( s.is_ok() ) {
+						meta.file_size  = builder->file_size();
+						meta.properties = builder->properties();
+					}
+				} else {
+					builder->abandon();
+				}
+				delete builder;
+				if ( s.is_ok() ) {
+					s = file->sync();
+				}
+				if ( s.is_ok() ) {
+					s = file->close();
+				}
+				delete file;
+				if ( !s.is_ok() || meta.file_size == 0 ) {
+					env_->remove_file( fname );
+				}
+			}
+			mtx_.lock();
+		}
+		for ( iterator* input: inputs ) {
+			delete input;
+		}
+
+		Log( options_.info_log, "Level-0 table #%llu: %lld bytes %s",
+				 static_cast< unsigned long long >( meta.number ), static_cast< long long >( meta.file_size ),
+				 s.to_string().c_str() );
+		pending_outputs_.erase( meta.number );
+
+		// Note that if file_size is zero, the file has been deleted and
+		// should not be added to the manifest.
+		if ( s.is_ok() && meta.file_size > 0 ) {
+			edit->add_file( 0, meta.number, meta.file_size, meta.smallest, meta.largest, meta.properties );
+		}
+		return s;
+	}
+
 	void db_impl::bg_work( void* db ) {
 		reinterpret_cast< db_impl* >( db )->background_call();
 	}
 
 	void db_impl::background_call() {
 		MutexLock lock( &mtx_ );
-		assert( background_compaction_scheduled_ );
+		assert( background_compactions_scheduled_ > 0 );
 
 		if ( shutting_down_.load( core::memory_order_acquire ) ) {
 			//
@@ -430,7 +759,7 @@ namespace simple_leveldb {
 			background_compaction();
 		}
 
-		background_compaction_scheduled_ = false;
+		background_compactions_scheduled_--;
 		MaybeScheduleCompaction();
 		background_work_finished_signal_.signal_all();
 	}
@@ -438,20 +767,22 @@ namespace simple_leveldb {
 	void db_impl::background_compaction() {
 		mtx_.assert_held();
 
-		if ( imm_ != nullptr ) {
-			compact_mem_table();
-			return;
-		}
-
 		compaction*  c;
-		bool         is_manual = ( manual_compaction_ != nullptr );
+		bool         is_manual = ( manual_compaction_ != nullptr && !manual_compaction_->in_progress );
 		internal_key manual_end;
 		if ( is_manual ) {
-			manual_compaction* m = manual_compaction_;
-			c                    = versions_->compact_range( m->level, m->begin, m->end );
-			m->done              = ( c == nullptr );
+			manual_compaction* m        = manual_compaction_;
+			bool               conflict = false;
+			c                           = versions_->compact_range( m->level, m->begin, m->end, &conflict );
+			if ( conflict ) {
+				// Retry once the compaction in the way is done.
+				compaction_blocked_ = true;
+				return;
+			}
+			m->done = ( c == nullptr );
 			if ( c != nullptr ) {
-				manual_end = c->input( 0, c->num_input_files( 0 ) - 1 )->largest;
+				m->in_progress = true;
+				manual_end     = c->input( 0, c->num_input_files( 0 ) - 1 )->largest;
 			}
 			Log( options_.info_log, "Manual compaction at level-%d from %s .. %s; will stop at %s\n",
 					 m->level, ( m->begin ? m->begin->debug_string().c_str() : "(begin)" ),
@@ -459,6 +790,15 @@ namespace simple_leveldb {
 					 ( m->done ? "(end)" : manual_end.debug_string().c_str() ) );
 		} else {
 			c = versions_->pick_compaction();
+			if ( c == nullptr ) {
+				compaction_blocked_ = true;
+			}
+		}
+
+		if ( c != nullptr ) {
+			// Its inputs are claimed; let another job look for a compaction
+			// that can run alongside this one.
+			MaybeScheduleCompaction();
 		}
 
 		status s;
@@ -468,14 +808,15 @@ namespace simple_leveldb {
 			assert( c->num_input_files( 0 ) == 1 );
 			file_meta_data* f = c->input( 0, 0 );
 			c->edit()->remove_file( c->level(), f->number );
-			c->edit()->add_file( c->level(), f->number, f->file_size, f->smallest, f->largest );
+			c->edit()->add_file( c->output_level(), f->number, f->file_size, f->smallest, f->largest,
+													 f->properties );
 			s = versions_->log_any_apply( c->edit(), &mtx_ );
 			if ( !s.is_ok() ) {
 				record_background_error( s );
 			}
 			version_set::level_summary_storage tmp;
 			Log( options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-					 static_cast< unsigned long long >( f->number ), c->level() + 1,
+					 static_cast< unsigned long long >( f->number ), c->output_level(),
 					 static_cast< unsigned long long >( f->file_size ),
 					 s.to_string().c_str(), versions_->level_summary( &tmp ) );
 		} else {
@@ -488,8 +829,356 @@ namespace simple_leveldb {
 			c->release_inputs();
 			RemoveObsoleteFiles();
 		}
+		if ( c != nullptr ) {
+			compaction_blocked_ = false;
+		}
 		delete c;
-		// todo!
+
+		if ( is_manual ) {
+			manual_compaction* m = manual_compaction_;
+			m->in_progress       = false;
+			if ( !s.is_ok() ) {
+				m->done = true;
+			}
+			if ( !m->done ) {
+				// We only compacted part of the requested range.  Update *m
+				// to the range that is left to be compacted.
+				m->tmp_storage = manual_end;
+				m->begin       = &m->tmp_storage;
+			}
+			manual_compaction_ = nullptr;
+		}
+	}
+
+	void db_impl::cleanup_compaction( compaction_state* compact ) {
+		mtx_.assert_held();
+		for ( sub_compaction_state& sub: compact->subs ) {
+			if ( sub.builder != nullptr ) {
+				// May happen if we get a shutdown call in the middle of compaction
+				sub.builder->abandon();
+				delete sub.builder;
+			} else {
+				assert( sub.outfile == nullptr );
+			}
+			delete sub.outfile;
+			for ( const auto& out: sub.outputs ) {
+				pending_outputs_.erase( out.number );
+			}
+			if ( sub.next_file_number != 0 ) {
+				pending_outputs_.erase( sub.next_file_number );
+			}
+		}
+		delete compact;
+	}
+
+	status db_impl::open_compaction_output_file( sub_compaction_state* sub ) {
+		assert( sub != nullptr );
+		assert( sub->builder == nullptr );
+		uint64_t file_number;
+		{
+			MutexLock lock( &mtx_ );
+			if ( sub->next_file_number != 0 ) {
+				file_number           = sub->next_file_number;
+				sub->next_file_number = 0;
+			} else {
+				file_number = versions_->new_file_number();
+				pending_outputs_.insert( file_number );
+			}
+			sub_compaction_state::output out;
+			out.number    = file_number;
+			out.file_size = 0;
+			sub->outputs.push_back( out );
+		}
+
+		const core::string fname = table_file_name( dbname_, file_number );
+		status             s     = open_writable_file( env_, fname, options_.use_direct_io_for_flush_and_compaction,
+																										 &sub->outfile );
+		if ( s.is_ok() ) {
+			if ( options_.rate_limiter != nullptr ) {
+				sub->outfile = new_rate_limited_file( sub->outfile, options_.rate_limiter, env::priority::kLow );
+			}
+			sub->builder = new table_builder( options_, sub->outfile );
+		}
+		return s;
+	}
+
+	status db_impl::finish_compaction_output_file( compaction_state* compact, sub_compaction_state* sub,
+																								 iterator* input ) {
+		assert( sub->outfile != nullptr );
+		assert( sub->builder != nullptr );
+
+		const uint64_t output_number = sub->current_output()->number;
+		assert( output_number != 0 );
+
+		// Check for iterator errors
+		status         s               = input->get_status();
+		const uint64_t current_entries = sub->builder->num_entries();
+		if ( s.is_ok() ) {
+			s = sub->builder->finish();
+		} else {
+			sub->builder->abandon();
+		}
+		const uint64_t current_bytes       = sub->builder->file_size();
+		sub->current_output()->file_size   = current_bytes;
+		sub->current_output()->properties  = sub->builder->properties();
+		sub->total_bytes                  += current_bytes;
+		delete sub->builder;
+		sub->builder = nullptr;
+
+		// Finish and check for file errors
+		if ( s.is_ok() ) {
+			s = sub->outfile->sync();
+		}
+		if ( s.is_ok() ) {
+			s = sub->outfile->close();
+		}
+		delete sub->outfile;
+		sub->outfile = nullptr;
+
+		if ( s.is_ok() && current_entries > 0 ) {
+			// Verify that the table is usable
+			cache::handle* handle = nullptr;
+			s                     = table_cache_->find_table( output_number, current_bytes, &handle );
+			if ( s.is_ok() ) {
+				table_cache_->release( handle );
+				Log( options_.info_log, "Generated table #%llu@%d: %lld keys, %lld bytes",
+						 static_cast< unsigned long long >( output_number ), compact->compaction->level(),
+						 static_cast< long long >( current_entries ), static_cast< long long >( current_bytes ) );
+			}
+		}
+		return s;
+	}
+
+	status db_impl::install_compaction_results( compaction_state* compact ) {
+		mtx_.assert_held();
+		compaction* const c           = compact->compaction;
+		int64_t           total_bytes = 0;
+		for ( const sub_compaction_state& sub: compact->subs ) {
+			total_bytes += sub.total_bytes;
+		}
+		Log( options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes", c->num_input_files( 0 ),
+				 c->level(), c->num_input_files( 1 ), c->output_level(), static_cast< long long >( total_bytes ) );
+
+		// Add compaction outputs.  The subs are in key order, so are theirs.
+		c->add_input_deletions( c->edit() );
+		const int32_t level = c->output_level();
+		for ( const sub_compaction_state& sub: compact->subs ) {
+			for ( const auto& out: sub.outputs ) {
+				c->edit()->add_file( level, out.number, out.file_size, out.smallest, out.largest,
+														 out.properties );
+			}
+		}
+		return versions_->log_any_apply( c->edit(), &mtx_ );
+	}
+
+	status db_impl::do_compaction_work( compaction_state* compact ) {
+		mtx_.assert_held();
+		compaction* const c = compact->compaction;
+		Log( options_.info_log, "Compacting %d@%d + %d@%d files", c->num_input_files( 0 ), c->level(),
+				 c->num_input_files( 1 ), c->output_level() );
+
+		compact->smallest_snapshot = versions_->last_sequence();
+
+		c->get_subcompaction_boundaries( options_.max_subcompactions, &compact->boundaries );
+		const size_t num_subs = compact->boundaries.size() + 1;
+		compact->subs.resize( num_subs );
+		for ( size_t i = 0; i < num_subs; i++ ) {
+			compact->subs[ i ].start = ( i == 0 ) ? nullptr : &compact->boundaries[ i - 1 ];
+			compact->subs[ i ].end   = ( i + 1 == num_subs ) ? nullptr : &compact->boundaries[ i ];
+		}
+		if ( num_subs > 1 ) {
+			Log( options_.info_log, "Compaction split into %d subcompactions", static_cast< int >( num_subs ) );
+		}
+		if ( c->output_level() == 0 ) {
+			// Level-0 files are ordered by number, so the output must be numbered
+			// before any memtable flushed while we work.
+			compact->subs[ 0 ].next_file_number = versions_->new_file_number();
+			pending_outputs_.insert( compact->subs[ 0 ].next_file_number );
+		}
+
+		// Release mutex while we're actually doing the compaction work
+		mtx_.unlock();
+
+		// Extra subcompactions get threads of their own rather than slots in
+		// the kLow pool, which may be busy with the very compactions waiting
+		// here.  The calling thread takes the first range.
+		port::mutex    done_mutex;
+		port::cond_var done_cv( &done_mutex );
+		size_t         running = num_subs - 1;
+		for ( size_t i = 1; i < num_subs; i++ ) {
+			env_->start_thread(
+				[ this, compact, &done_mutex, &done_cv, &running ]( void* arg ) {
+					do_subcompaction_work( compact, reinterpret_cast< sub_compaction_state* >( arg ) );
+					MutexLock l( &done_mutex );
+					if ( --running == 0 ) {
+						done_cv.signal_all();
+					}
+				},
+				&compact->subs[ i ] );
+		}
+		do_subcompaction_work( compact, &compact->subs[ 0 ] );
+		{
+			MutexLock l( &done_mutex );
+			while ( running > 0 ) {
+				done_cv.wait();
+			}
+		}
+
+		status s;
+		for ( const sub_compaction_state& sub: compact->subs ) {
+			if ( !sub.s.is_ok() ) {
+				s = sub.s;
+				break;
+			}
+		}
+		if ( s.is_ok() && shutting_down_.load( core::memory_order_acquire ) ) {
+			s = status::io_error( "Deleting DB during compaction" );
+		}
+
+		mtx_.lock();
+		if ( s.is_ok() ) {
+			s = install_compaction_results( compact );
+		}
+		version_set::level_summary_storage tmp;
+		Log( options_.info_log, "compacted to: %s", versions_->level_summary( &tmp ) );
+		return s;
+	}
+
+	// Compact the inputs of compact->compaction within the range of "sub".
+	// Runs without mtx_ held, concurrently with the other subs.
+	void db_impl::do_subcompaction_work( compaction_state* compact, sub_compaction_state* sub ) {
+		compaction* const c     = compact->compaction;
+		iterator*         input = versions_->make_input_iterator( c );
+		if ( sub->start != nullptr ) {
+			internal_key start( *sub->start, kMaxSequenceNumber, kValueTypeForSeek );
+			input->seek( start.encode() );
+		} else {
+			input->seek_to_first();
+		}
+
+		const comparator*              ucmp   = user_comparator();
+		const compaction_filter* const filter = options_.compaction_filter;
+		compaction_filter::context     filter_context;
+		filter_context.level               = c->level();
+		filter_context.output_level        = c->output_level();
+		filter_context.is_bottommost_level = c->is_bottommost_level();
+
+		status              s;
+		parsed_internal_key ikey;
+		core::string        current_user_key;
+		bool                has_current_user_key  = false;
+		sequence_number     last_sequence_for_key = kMaxSequenceNumber;
+		core::string        filtered_key;
+		core::string        filtered_value;
+		while ( input->valid() && !shutting_down_.load( core::memory_order_acquire ) ) {
+			slice      key    = input->key();
+			slice      value  = input->value();
+			const bool parsed = parse_internal_key( key, &ikey );
+			if ( parsed && sub->end != nullptr && ucmp->compare( ikey.user_key, *sub->end ) >= 0 ) {
+				break;
+			}
+
+			if ( c->should_stop_before( key, &sub->cursor ) && sub->builder != nullptr ) {
+				s = finish_compaction_output_file( compact, sub, input );
+				if ( !s.is_ok() ) {
+					break;
+				}
+			}
+
+			// Handle key/value, add to state, etc.
+			bool drop = false;
+			if ( !parsed ) {
+				// Do not hide error keys
+				current_user_key.clear();
+				has_current_user_key  = false;
+				last_sequence_for_key = kMaxSequenceNumber;
+			} else {
+				if ( !has_current_user_key || ucmp->compare( ikey.user_key, current_user_key ) != 0 ) {
+					// First occurrence of this user key
+					current_user_key.assign( ikey.user_key.data(), ikey.user_key.size() );
+					has_current_user_key  = true;
+					last_sequence_for_key = kMaxSequenceNumber;
+				}
+
+				if ( last_sequence_for_key <= compact->smallest_snapshot ) {
+					// Hidden by an newer entry for same user key
+					drop = true;
+				} else if ( ikey.type == value_type::kTypeDeletion &&
+										ikey.sequence <= compact->smallest_snapshot &&
+										c->is_base_level_for_key( ikey.user_key, &sub->cursor ) ) {
+					// For this user key:
+					// (1) there is no data in higher levels
+					// (2) data in lower levels will have larger sequence numbers
+					// (3) data in layers that are being compacted here and have
+					//     smaller sequence numbers will be dropped in the next
+					//     few iterations of this loop (by rule (A) above).
+					// Therefore this deletion marker is obsolete and can be dropped.
+					drop = true;
+				} else if ( filter != nullptr && ikey.type == value_type::kTypeValue &&
+										ikey.sequence <= compact->smallest_snapshot ) {
+					// Newest value of the key, and no snapshot reads an older one.
+					filtered_value.clear();
+					switch ( filter->filter( filter_context, ikey.user_key, value, &filtered_value ) ) {
+						case compaction_filter::decision::kKeep:
+							break;
+						case compaction_filter::decision::kChangeValue:
+							value = filtered_value;
+							break;
+						case compaction_filter::decision::kRemove:
+							if ( c->is_base_level_for_key( ikey.user_key, &sub->cursor ) ) {
+								// Nothing older to hide, as for deletions above.
+								drop = true;
+							} else {
+								// Older values may live below the output; hide them with a
+								// deletion of the same sequence number.
+								value_type deletion = value_type::kTypeDeletion;
+								filtered_key.clear();
+								append_internal_key( &filtered_key,
+																		 parsed_internal_key( ikey.user_key, ikey.sequence, deletion ) );
+								key   = filtered_key;
+								value = slice();
+							}
+							break;
+					}
+				}
+
+				last_sequence_for_key = ikey.sequence;
+			}
+
+			if ( !drop ) {
+				// Open output file if necessary
+				if ( sub->builder == nullptr ) {
+					s = open_compaction_output_file( sub );
+					if ( !s.is_ok() ) {
+						break;
+					}
+				}
+				if ( sub->builder->num_entries() == 0 ) {
+					sub->current_output()->smallest.decode_from( key );
+				}
+				sub->current_output()->largest.decode_from( key );
+				sub->builder->add( key, value );
+
+				// Close output file if it is big enough
+				if ( sub->builder->file_size() >= c->max_output_file_size() ) {
+					s = finish_compaction_output_file( compact, sub, input );
+					if ( !s.is_ok() ) {
+						break;
+					}
+				}
+			}
+
+			input->next();
+		}
+
+		if ( s.is_ok() && sub->builder != nullptr ) {
+			s = finish_compaction_output_file( compact, sub, input );
+		}
+		if ( s.is_ok() ) {
+			s = input->get_status();
+		}
+		delete input;
+		sub->s = s;
 	}
 
 	template < class T, class V >
@@ -503,10 +1192,17 @@ namespace simple_leveldb {
 		options result       = src;
 		result.comparator    = icmp;
 		result.filter_policy = ( src.filter_policy != nullptr ) ? i_policy : nullptr;
-		clip_to_range( &result.max_open_files, 64 + kNumNonTableCacheFiles, 50000 );
+		if ( result.max_open_files != -1 ) {
+			clip_to_range( &result.max_open_files, 64 + kNumNonTableCacheFiles, 50000 );
+		}
 		clip_to_range( &result.write_buffer_size, 64 << 10, 1 << 30 );
+		clip_to_range( &result.max_write_buffer_number, 2, 64 );
+		clip_to_range( &result.min_write_buffer_number_to_merge, 1, result.max_write_buffer_number - 1 );
 		clip_to_range( &result.max_file_size, 1 << 20, 1 << 30 );
+		clip_to_range( &result.max_subcompactions, 1, 64 );
+		clip_to_range( &result.max_background_compactions, 1, 64 );
 		clip_to_range( &result.block_size, 1 << 10, 4 << 20 );
+		clip_to_range( &result.metadata_block_size, 1 << 10, 4 << 20 );
 
 		if ( result.info_log == nullptr ) {
 			src.env->create_dir( dbname );
@@ -14,16 +14,32 @@ namespace simple_leveldb {
 	logger::~logger()                         = default;
 	file_lock::~file_lock()                   = default;
 
+	bool random_access_file::reads_in_place() const { return false; }
+
+	status random_access_file::will_need( uint64_t offset, size_t n ) { return status::ok(); }
+
 	status env::new_appendable_file( const core::string& fname, writable_file** result ) {
 		return status::not_supported( "new_appendable_file", fname );
 	}
 
+	status env::new_direct_random_access_file( const core::string& fname, random_access_file** result ) {
+		return status::not_supported( "new_direct_random_access_file", fname );
+	}
+
+	status env::new_direct_writable_file( const core::string& fname, writable_file** result ) {
+		return status::not_supported( "new_direct_writable_file", fname );
+	}
+
 	status env::remove_file( const core::string& filename ) { return delete_file( filename ); }
 	status env::delete_file( const core::string& filename ) { return remove_file( filename ); }
 
 	status env::remove_dir( const core::string& dirname ) { return delete_dir( dirname ); }
 	status env::delete_dir( const core::string& dirname ) { return remove_dir( dirname ); }
 
+	void env::set_background_threads( int32_t number, priority pri ) {}
+
+	int32_t env::get_background_threads( priority pri ) { return 1; }
+
 	void Log( logger* info_log, const char* format, ... ) {
 		if ( info_log != nullptr ) {
 			::va_list ap;
@@ -86,4 +102,26 @@ namespace simple_leveldb {
 		return do_write_string_to_file( env, data, fname, true );
 	}
 
+	status open_random_access_file( env* env, const core::string& fname, bool use_direct_io,
+																	random_access_file** result ) {
+		if ( use_direct_io ) {
+			status s = env->new_direct_random_access_file( fname, result );
+			if ( !s.is_not_supported() ) {
+				return s;
+			}
+		}
+		return env->new_random_access_file( fname, result );
+	}
+
+	status open_writable_file( env* env, const core::string& fname, bool use_direct_io,
+														 writable_file** result ) {
+		if ( use_direct_io ) {
+			status s = env->new_direct_writable_file( fname, result );
+			if ( !s.is_not_supported() ) {
+				return s;
+			}
+		}
+		return env->new_writable_file( fname, result );
+	}
+
 }// namespace simple_leveldb
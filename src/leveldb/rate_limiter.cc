@@ -0,0 +1,260 @@
+#include "leveldb/rate_limiter.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutex_lock.h"
+
+namespace simple_leveldb {
+
+	rate_limiter::~rate_limiter() = default;
+
+	namespace {
+
+		// Token bucket
+		//
+		// available_bytes_ is topped up to one period's worth of bytes at
+		// every refill, and requests that do not fit wait in one FIFO queue
+		// per priority.  There is no refill thread: the first waiter sleeps
+		// until the next refill is due, refills, grants as many queued
+		// requests as the bytes allow and wakes the others.  If the granted
+		// waiter was the sleeper, the next waiter takes its place.
+		//
+		// kHigh is served first, except on every kFairness-th refill, when
+		// kLow goes first so that a steady stream of flushes cannot starve
+		// compactions.
+		//
+		// Auto-tuning counts the periods in which a request had to wait.  Every
+		// kRefillsPerTune periods the rate goes up by 5% if more than 90% of
+		// them were drained, and down by 5% if fewer than 50% were.
+		static const int64_t kFairness        = 10;
+		static const int64_t kRefillsPerTune  = 100;
+		static const int64_t kMinRateDivisor  = 20;
+		static const int64_t kMicrosPerSecond = 1000 * 1000;
+
+		// Refills are timed with a monotonic clock: env::now_micros() is wall
+		// time, and a clock stepping backwards would stall every writer until
+		// it caught up with next_refill_us_.
+		static uint64_t monotonic_micros() {
+			return static_cast< uint64_t >( core::chrono::duration_cast< core::chrono::microseconds >(
+																				core::chrono::steady_clock::now().time_since_epoch() )
+																				.count() );
+		}
+
+		class generic_rate_limiter : public rate_limiter {
+		private:
+			struct req {
+				int64_t bytes;
+				bool    granted;
+			};
+
+			env* const    env_;
+			const int64_t refill_period_us_;
+			const bool    auto_tuned_;
+
+			mutable port::mutex mutex_;
+			port::cond_var      cv_;
+			int64_t             max_bytes_per_second_ GUARDED_BY( mutex_ );
+			int64_t             bytes_per_second_ GUARDED_BY( mutex_ );
+			int64_t             refill_bytes_ GUARDED_BY( mutex_ );
+			int64_t             available_bytes_ GUARDED_BY( mutex_ );
+			uint64_t            next_refill_us_ GUARDED_BY( mutex_ );
+			bool                sleeper_ GUARDED_BY( mutex_ );// A waiter sleeps until the next refill
+			int64_t             refills_ GUARDED_BY( mutex_ );
+			bool                drained_ GUARDED_BY( mutex_ );// A request waited this period
+			int64_t             num_drains_ GUARDED_BY( mutex_ );
+			int64_t             tune_refills_ GUARDED_BY( mutex_ );
+			core::deque< req* > queue_[ 2 ] GUARDED_BY( mutex_ );// Indexed by env::priority
+			int64_t             total_bytes_[ 2 ] GUARDED_BY( mutex_ );
+
+			static int index( env::priority pri ) { return pri == env::priority::kHigh ? 0 : 1; }
+
+			// REQUIRES: mutex_ held
+			void set_rate( int64_t bytes_per_second ) {
+				bytes_per_second_ = core::max< int64_t >( 1, bytes_per_second );
+				refill_bytes_     = core::max< int64_t >( 1, bytes_per_second_ * refill_period_us_ / kMicrosPerSecond );
+			}
+
+			// Grant queued requests from the front of queue "i" while they fit.
+			// Returns false if one did not.
+			// REQUIRES: mutex_ held
+			bool grant( int i ) {
+				core::deque< req* >& q = queue_[ i ];
+				while ( !q.empty() ) {
+					req* r = q.front();
+					if ( r->bytes > available_bytes_ ) {
+						return false;
+					}
+					available_bytes_ -= r->bytes;
+					total_bytes_[ i ] += r->bytes;
+					r->granted         = true;
+					q.pop_front();
+				}
+				return true;
+			}
+
+			// REQUIRES: mutex_ held
+			void tune() {
+				const int64_t drained_pct = num_drains_ * 100 / tune_refills_;
+				if ( drained_pct > 90 ) {
+					set_rate( core::min( max_bytes_per_second_, bytes_per_second_ * 105 / 100 + 1 ) );
+				} else if ( drained_pct < 50 ) {
+					set_rate( core::max( max_bytes_per_second_ / kMinRateDivisor, bytes_per_second_ * 100 / 105 ) );
+				}
+				num_drains_   = 0;
+				tune_refills_ = 0;
+			}
+
+			// REQUIRES: mutex_ held
+			void refill() {
+				const uint64_t now = monotonic_micros();
+				if ( now < next_refill_us_ ) {
+					return;
+				}
+				next_refill_us_  = now + refill_period_us_;
+				available_bytes_ = core::min( available_bytes_ + refill_bytes_, refill_bytes_ );
+				refills_++;
+				if ( auto_tuned_ ) {
+					num_drains_ += drained_ ? 1 : 0;
+					if ( ++tune_refills_ >= kRefillsPerTune ) {
+						tune();
+					}
+				}
+				drained_ = false;
+
+				const int first = refills_ % kFairness == 0 ? 1 : 0;
+				if ( grant( first ) ) {
+					grant( 1 - first );
+				}
+				cv_.signal_all();
+			}
+
+			// Wait for up to one refill worth of "bytes" and return how many
+			// were granted.
+			int64_t acquire( int64_t bytes, env::priority pri ) {
+				const int i = index( pri );
+				MutexLock l( &mutex_ );
+				refill();
+				bytes = core::min( bytes, refill_bytes_ );
+				if ( queue_[ 0 ].empty() && queue_[ 1 ].empty() && bytes <= available_bytes_ ) {
+					available_bytes_ -= bytes;
+					total_bytes_[ i ] += bytes;
+					return bytes;
+				}
+
+				req r{ bytes, false };
+				queue_[ i ].push_back( &r );
+				drained_ = true;
+				while ( !r.granted ) {
+					if ( sleeper_ ) {
+						cv_.wait();
+						continue;
+					}
+					sleeper_             = true;
+					const uint64_t now   = monotonic_micros();
+					const int64_t  delay = next_refill_us_ > now
+																	 ? core::min( static_cast< int64_t >( next_refill_us_ - now ), refill_period_us_ )
+																	 : 0;
+					mutex_.unlock();
+					env_->sleep_for_microseconds( static_cast< int32_t >( delay ) );
+					mutex_.lock();
+					sleeper_ = false;
+					refill();
+					cv_.signal_all();// Let another waiter take over sleeping
+				}
+				return bytes;
+			}
+
+		public:
+			generic_rate_limiter( int64_t bytes_per_second, int64_t refill_period_us, bool auto_tuned, env* env )
+					: env_( env )
+					, refill_period_us_( core::max< int64_t >( 1, refill_period_us ) )
+					, auto_tuned_( auto_tuned )
+					, cv_( &mutex_ )
+					, max_bytes_per_second_( bytes_per_second )
+					, available_bytes_( 0 )
+					, next_refill_us_( 0 )
+					, sleeper_( false )
+					, refills_( 0 )
+					, drained_( false )
+					, num_drains_( 0 )
+					, tune_refills_( 0 )
+					, total_bytes_{ 0, 0 } {
+				// Start auto-tuning halfway up, so it can move either way.
+				set_rate( auto_tuned_ ? bytes_per_second / 2 : bytes_per_second );
+			}
+
+			~generic_rate_limiter() override {
+				MutexLock l( &mutex_ );
+				assert( queue_[ 0 ].empty() && queue_[ 1 ].empty() );
+			}
+
+			void request( int64_t bytes, env::priority pri ) override {
+				while ( bytes > 0 ) {
+					bytes -= acquire( bytes, pri );
+				}
+			}
+
+			void set_bytes_per_second( int64_t bytes_per_second ) override {
+				MutexLock l( &mutex_ );
+				max_bytes_per_second_ = bytes_per_second;
+				if ( !auto_tuned_ || bytes_per_second_ > max_bytes_per_second_ ) {
+					set_rate( bytes_per_second );
+				}
+			}
+
+			int64_t get_bytes_per_second() const override {
+				MutexLock l( &mutex_ );
+				return bytes_per_second_;
+			}
+
+			int64_t get_total_bytes_through( env::priority pri ) const override {
+				MutexLock l( &mutex_ );
+				return total_bytes_[ index( pri ) ];
+			}
+		};
+
+		class rate_limited_file : public writable_file {
+		private:
+			writable_file* const base_;
+			rate_limiter* const  limiter_;
+			const env::priority  pri_;
+
+		public:
+			rate_limited_file( writable_file* base, rate_limiter* limiter, env::priority pri )
+					: base_( base )
+					, limiter_( limiter )
+					, pri_( pri ) {}
+
+			~rate_limited_file() override { delete base_; }
+
+			status append( const slice& data ) override {
+				limiter_->request( static_cast< int64_t >( data.size() ), pri_ );
+				return base_->append( data );
+			}
+
+			status close() override { return base_->close(); }
+			status flush() override { return base_->flush(); }
+			status sync() override { return base_->sync(); }
+		};
+
+	}// end anonymous namespace
+
+	rate_limiter* new_generic_rate_limiter( int64_t bytes_per_second, int64_t refill_period_us, bool auto_tuned,
+																					env* env ) {
+		return new generic_rate_limiter( bytes_per_second, refill_period_us, auto_tuned, env );
+	}
+
+	writable_file* new_rate_limited_file( writable_file* base, rate_limiter* limiter, env::priority pri ) {
+		return new rate_limited_file( base, limiter, pri );
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,388 @@
+#include "leveldb/cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "leveldb/__detail/secondary_tier.h"
+#include "leveldb/slice.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutex_lock.h"
+
+namespace simple_leveldb {
+
+	secondary_tier::~secondary_tier() = default;
+
+	namespace {
+
+		// Two-tier cache
+		//
+		// The primary tier is any cache and holds values as objects.  Every value
+		// stored in it is wrapped in a tiered_entry so that the primary's deleter,
+		// a plain function pointer, can find its way back to the tiered_cache.
+		// When the primary drops an entry that came with an item_helper, the
+		// deleter "demotes" it: the helper's bytes are compressed and handed to
+		// the secondary_tier before the object itself is destroyed.
+		//
+		// Only the newest entry of a key is demoted.  Every entry gets a
+		// generation number, and newest_ maps each key with entries alive in
+		// the primary to the generation of the newest one.  insert() gives
+		// the key a new generation and erase() bumps it, so copies that were
+		// replaced or erased are dropped on the way out instead of bringing
+		// old data back from the tier.  Neither has to look the key up in
+		// the primary, which would count as an access there.
+		//
+		// The deleter runs under a lock of the primary, so it only queues the
+		// demoted bytes; they reach the tier, which may do file I/O, once the
+		// primary call that evicted them has returned.  flush_mutex_ orders
+		// those writes with the tier erase of insert() and erase().
+		//
+		// Bytes handed to the tier start with one byte saying whether the rest
+		// is snappy compressed and whether the entry had priority::kHigh, so
+		// that it comes back with the same priority.
+		class tiered_cache;
+
+		struct tiered_entry {
+			tiered_cache*             owner;
+			void*                     value;
+			cache::deleter_type       deleter;
+			const cache::item_helper* helper;// nullptr if inserted without a helper
+			cache::priority           priority;
+			uint64_t                  generation;
+		};
+
+		enum : char {
+			kRaw    = 0,
+			kSnappy = 1,
+		};
+
+		static const char kCompressionMask = 0x0f;
+		static const char kHighPriority    = 0x10;
+
+		class tiered_cache : public cache {
+		private:
+			cache* const          primary_;
+			secondary_tier* const tier_;
+			bool                  shutting_down_;
+
+			struct newest_entry {
+				uint64_t generation;
+				int32_t  live;// Entries of the key not yet deleted
+			};
+
+			port::mutex                                              pending_mutex_;
+			uint64_t                                                 next_generation_ GUARDED_BY( pending_mutex_ );
+			core::unordered_map< core::string, newest_entry >        newest_ GUARDED_BY( pending_mutex_ );
+			core::vector< core::pair< core::string, core::string > > pending_ GUARDED_BY( pending_mutex_ );
+			port::mutex                                              flush_mutex_;// Held while writing to tier_
+
+			static void delete_tiered_entry( const slice& key, void* value ) {
+				tiered_entry* e = reinterpret_cast< tiered_entry* >( value );
+				e->owner->retire( key, e );
+				e->deleter( key, e->value );
+				delete e;
+			}
+
+			static tiered_entry* entry( cache* c, handle* h ) {
+				return reinterpret_cast< tiered_entry* >( c->value( h ) );
+			}
+
+			// Give "key" a generation newer than all of its entries so far, so
+			// that none of them is demoted anymore, and drop bytes queued for
+			// it.  If "add" is true, an entry of the new generation is about
+			// to be inserted.  Returns the new generation.
+			uint64_t supersede( const slice& key, bool add ) {
+				const core::string k = key.to_string();
+				MutexLock          l( &pending_mutex_ );
+				const uint64_t     generation = ++next_generation_;
+				auto               it         = newest_.find( k );
+				if ( it != newest_.end() ) {
+					it->second.generation  = generation;
+					it->second.live       += add ? 1 : 0;
+				} else if ( add ) {
+					newest_.emplace( k, newest_entry{ generation, 1 } );
+				}
+				core::erase_if( pending_, [ &k ]( const auto& p ) { return p.first == k; } );
+				return generation;
+			}
+
+			// Drop the tier's copy of "key", after any write of it in flight.
+			void erase_from_tier( const slice& key ) {
+				MutexLock l( &flush_mutex_ );
+				tier_->erase( key );
+			}
+
+			handle* wrap( const slice& key, void* value, size_t charge, deleter_type deleter,
+										const item_helper* helper, priority priority, uint64_t generation ) {
+				tiered_entry* e = new tiered_entry;
+				e->owner        = this;
+				e->value        = value;
+				e->deleter      = deleter;
+				e->helper       = helper;
+				e->priority     = priority;
+				e->generation   = generation;
+				handle* h       = primary_->insert( key, e, charge, &delete_tiered_entry, priority );
+				flush_demoted();
+				return h;
+			}
+
+			// Hand the bytes queued by retire() to the tier.
+			void flush_demoted() {
+				{
+					MutexLock l( &pending_mutex_ );
+					if ( pending_.empty() ) {
+						return;
+					}
+				}
+				core::vector< core::pair< core::string, core::string > > pending;
+				MutexLock                                                l( &flush_mutex_ );
+				{
+					MutexLock l( &pending_mutex_ );
+					pending.swap( pending_ );
+				}
+				for ( const auto& [ key, data ]: pending ) {
+					tier_->insert( key, data );
+				}
+			}
+
+			// "e" leaves the primary.  Queue its bytes for the tier if it has
+			// a helper and is still the newest entry of "key".
+			void retire( const slice& key, tiered_entry* e ) {
+				core::string data;
+				if ( e->helper != nullptr && !shutting_down_ ) {
+					encode( e, &data );
+				}
+				const core::string k = key.to_string();
+				MutexLock          l( &pending_mutex_ );
+				auto               it = newest_.find( k );
+				assert( it != newest_.end() );
+				const bool newest = ( it->second.generation == e->generation );
+				if ( --it->second.live == 0 ) {
+					newest_.erase( it );
+				}
+				if ( newest && !data.empty() ) {
+					pending_.emplace_back( k, core::move( data ) );
+				}
+			}
+
+			// Store the bytes of "e" in "*data".  Only compress if that saves
+			// at least 12.5%, as table_builder would.
+			static void encode( const tiered_entry* e, core::string* data ) {
+				const char   flags = ( e->priority == priority::kHigh ) ? kHighPriority : 0;
+				const slice  raw   = e->helper->contents( e->value );
+				core::string compressed;
+				if ( port::Snappy_Compress( raw.data(), raw.size(), &compressed ) &&
+						 compressed.size() < raw.size() - ( raw.size() / 8u ) ) {
+					data->reserve( 1 + compressed.size() );
+					data->push_back( kSnappy | flags );
+					data->append( compressed );
+				} else {
+					data->reserve( 1 + raw.size() );
+					data->push_back( kRaw | flags );
+					data->append( raw.data(), raw.size() );
+				}
+			}
+
+			// Turn bytes from the tier back into what the helper was given.
+			static bool decode( const core::string& data, core::string* scratch, slice* contents,
+													priority* priority ) {
+				if ( data.empty() ) {
+					return false;
+				}
+				const char   type    = data[ 0 ] & kCompressionMask;
+				const char*  payload = data.data() + 1;
+				const size_t n       = data.size() - 1;
+				*priority            = ( data[ 0 ] & kHighPriority ) != 0 ? priority::kHigh : priority::kLow;
+				if ( type == kRaw ) {
+					*contents = slice( payload, n );
+					return true;
+				}
+				size_t ulength;
+				if ( type != kSnappy || !port::Snappy_GetUncompressedLength( payload, n, &ulength ) ) {
+					return false;
+				}
+				scratch->resize( ulength );
+				if ( !port::Snappy_Uncompress( payload, n, &( *scratch )[ 0 ] ) ) {
+					return false;
+				}
+				*contents = *scratch;
+				return true;
+			}
+
+		public:
+			tiered_cache( cache* primary, secondary_tier* tier )
+					: primary_( primary )
+					, tier_( tier )
+					, shutting_down_( false )
+					, next_generation_( 0 ) {}
+
+			~tiered_cache() override {
+				shutting_down_ = true;
+				delete primary_;
+				delete tier_;
+			}
+
+			handle* insert( const slice& key, void* value, size_t charge, deleter_type deleter,
+											priority priority = priority::kLow ) override {
+				const uint64_t generation = supersede( key, true );
+				erase_from_tier( key );
+				return wrap( key, value, charge, deleter, nullptr, priority, generation );
+			}
+
+			handle* insert_item( const slice& key, void* value, size_t charge, const item_helper* helper,
+													 priority priority = priority::kLow ) override {
+				const uint64_t generation = supersede( key, true );
+				erase_from_tier( key );
+				return wrap( key, value, charge, helper->deleter, helper, priority, generation );
+			}
+
+			// Reservations have no value to demote, so they go to the primary
+			// as they are.
+			handle* insert_reservation( const slice& key, size_t charge ) override {
+				return primary_->insert_reservation( key, charge );
+			}
+
+			handle* look_up( const slice& key ) override { return primary_->look_up( key ); }
+
+			handle* look_up_item( const slice& key, const item_helper* helper ) override {
+				handle* h = primary_->look_up( key );
+				if ( h != nullptr ) {
+					return h;
+				}
+				core::string data;
+				if ( !tier_->look_up( key, &data ) ) {
+					return nullptr;
+				}
+				core::string scratch;
+				slice        contents;
+				priority     priority;
+				if ( !decode( data, &scratch, &contents, &priority ) ) {
+					erase_from_tier( key );
+					return nullptr;
+				}
+				size_t charge;
+				void*  value = helper->create( contents, &charge );
+
+				tier_->promoted( key );
+				return wrap( key, value, charge, helper->deleter, helper, priority, supersede( key, true ) );
+			}
+
+			void release( handle* handle ) override {
+				primary_->release( handle );
+				flush_demoted();
+			}
+
+			void* value( handle* handle ) override { return entry( primary_, handle )->value; }
+
+			void erase( const slice& key ) override {
+				supersede( key, false );
+				primary_->erase( key );
+				erase_from_tier( key );
+				flush_demoted();
+			}
+
+			uint64_t new_id() override { return primary_->new_id(); }
+
+			void prune() override {
+				// Unreferenced primary entries are demoted on the way out, so
+				// prune the second tier last.
+				primary_->prune();
+				flush_demoted();
+				tier_->prune();
+			}
+
+			size_t total_charge() const override {
+				return primary_->total_charge() + tier_->total_charge();
+			}
+
+			// Counters are those of the primary; a second-tier hit shows up as
+			// a primary miss followed by an insert.
+			int  shard_count() const override { return primary_->shard_count(); }
+			void get_shard_stats( int shard, stats* stats ) const override {
+				primary_->get_shard_stats( shard, stats );
+			}
+		};
+
+		// secondary_tier on top of an LRU cache of strings.
+		class memory_tier : public secondary_tier {
+		private:
+			cache* const cache_;
+
+			static void delete_data( const slice&, void* value ) {
+				delete reinterpret_cast< core::string* >( value );
+			}
+
+		public:
+			explicit memory_tier( size_t capacity )
+					: cache_( new_lru_cache( capacity ) ) {}
+
+			~memory_tier() override { delete cache_; }
+
+			void insert( const slice& key, const slice& data ) override {
+				core::string* copy = new core::string( data.data(), data.size() );
+				cache_->release( cache_->insert( key, copy, copy->size(), &delete_data ) );
+			}
+
+			bool look_up( const slice& key, core::string* data ) override {
+				cache::handle* h = cache_->look_up( key );
+				if ( h == nullptr ) {
+					return false;
+				}
+				*data = *reinterpret_cast< core::string* >( cache_->value( h ) );
+				cache_->release( h );
+				return true;
+			}
+
+			void promoted( const slice& key ) override { cache_->erase( key ); }
+
+			void erase( const slice& key ) override { cache_->erase( key ); }
+
+			void prune() override { cache_->prune(); }
+
+			size_t total_charge() const override { return cache_->total_charge(); }
+		};
+
+	}// end anonymous namespace
+
+	cache* new_tiered_cache( cache* primary, secondary_tier* tier ) {
+		return new tiered_cache( primary, tier );
+	}
+
+	secondary_tier* new_memory_tier( size_t capacity ) { return new memory_tier( capacity ); }
+
+	cache* new_compressed_tiered_cache( cache* primary, size_t secondary_capacity ) {
+		return new_tiered_cache( primary, new_memory_tier( secondary_capacity ) );
+	}
+
+	status new_persistent_tiered_cache( cache* primary, env* env, const core::string& dir,
+																			size_t capacity, cache** result ) {
+		// Small tiers use 16 files, so dropping the oldest file frees a
+		// sixteenth.  Files stop growing at kMaxFileSize, since each one is
+		// buffered in memory before it is written out, and the file count grows
+		// instead until it reaches kMaxFiles.  Past that, file size grows with
+		// capacity again so the number of open files stays bounded.
+		static const size_t kMinFileSize = 64 * 1024;
+		static const size_t kMaxFileSize = 4 * 1024 * 1024;
+		static const size_t kMaxFiles    = 1024;
+		size_t              file_size    = core::clamp( capacity / 16, kMinFileSize, kMaxFileSize );
+		if ( capacity / file_size > kMaxFiles ) {
+			file_size = ( capacity + kMaxFiles - 1 ) / kMaxFiles;
+		}
+
+		secondary_tier* tier;
+		status          s = new_file_tier( env, dir, capacity, file_size, &tier );
+		if ( !s.is_ok() ) {
+			*result = nullptr;
+			return s;
+		}
+		*result = new_tiered_cache( primary, tier );
+		return s;
+	}
+
+}// namespace simple_leveldb
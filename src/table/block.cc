@@ -0,0 +1,456 @@
+// Decodes the blocks generated by block_builder.cc.
+
+#include "table/block.h"
+#include "leveldb/__detail/db_format.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/data_block_hash_index.h"
+#include "table/format.h"
+#include "util/coding.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace simple_leveldb {
+
+	block::block( const block_contents& contents )
+			: data_( contents.data.data() )
+			, size_( contents.data.size() )
+			, num_restarts_( 0 )
+			, owned_( contents.heap_allocated )
+			, has_hash_index_( false ) {
+		if ( size_ < sizeof( uint32_t ) ) {
+			size_ = 0;// Error marker
+			return;
+		}
+
+		const uint32_t packed       = decode_fixed32( data_ + size_ - sizeof( uint32_t ) );
+		size_t         restarts_end = size_ - sizeof( uint32_t );
+		num_restarts_               = packed & ~kDataBlockHashIndexFlag;
+		if ( ( packed & kDataBlockHashIndexFlag ) != 0 ) {
+			size_t map_offset;
+			if ( !hash_index_.initialize( data_, restarts_end, &map_offset ) ) {
+				size_ = 0;
+				return;
+			}
+			restarts_end    = map_offset;
+			has_hash_index_ = true;
+		}
+
+		size_t max_restarts_allowed = restarts_end / sizeof( uint32_t );
+		if ( num_restarts_ > max_restarts_allowed ) {
+			// The size is too small for num_restarts_
+			size_ = 0;
+		} else {
+			restart_offset_ = restarts_end - num_restarts_ * sizeof( uint32_t );
+		}
+	}
+
+	block::~block() {
+		if ( owned_ ) {
+			delete[] data_;
+		}
+	}
+
+	// Helper routine: decode the next block entry starting at "p",
+	// storing the number of shared key bytes, non_shared key bytes,
+	// and the length of the value in "*shared", "*non_shared", and
+	// "*value_length", respectively.  Will not dereference past "limit".
+	//
+	// If any errors are detected, returns nullptr.  Otherwise, returns a
+	// pointer to the key delta (just past the three decoded values).
+	static inline const char* decode_entry( const char* p, const char* limit,
+																					uint32_t* shared, uint32_t* non_shared,
+																					uint32_t* value_length ) {
+		if ( limit - p < 3 ) return nullptr;
+		*shared       = reinterpret_cast< const uint8_t* >( p )[ 0 ];
+		*non_shared   = reinterpret_cast< const uint8_t* >( p )[ 1 ];
+		*value_length = reinterpret_cast< const uint8_t* >( p )[ 2 ];
+		if ( ( *shared | *non_shared | *value_length ) < 128 ) {
+			// Fast path: all three values are encoded in one byte each
+			p += 3;
+		} else {
+			if ( ( p = get_varint32ptr( p, limit, shared ) ) == nullptr ) return nullptr;
+			if ( ( p = get_varint32ptr( p, limit, non_shared ) ) == nullptr ) return nullptr;
+			if ( ( p = get_varint32ptr( p, limit, value_length ) ) == nullptr ) return nullptr;
+		}
+
+		if ( static_cast< uint32_t >( limit - p ) < ( *non_shared + *value_length ) ) {
+			return nullptr;
+		}
+		return p;
+	}
+
+	class block::iter : public iterator {
+	private:
+		const comparator* const            comparator_;
+		const char* const                  data_;        // underlying block contents
+		uint32_t const                     restarts_;    // Offset of restart array (list of fixed32)
+		uint32_t const                     num_restarts_;// Number of uint32_t entries in restart array
+		const data_block_hash_index* const hash_index_;  // nullptr if the block has none
+
+		// current_ is offset in data_ of current entry.  >= restarts_ if !valid
+		uint32_t     current_;
+		uint32_t     restart_index_;// Index of restart block in which current_ falls
+		core::string key_;
+		slice        value_;
+		status       status_;
+
+	public:
+		iter( const comparator* comparator, const char* data, uint32_t restarts,
+					uint32_t num_restarts, const data_block_hash_index* hash_index )
+				: comparator_( comparator )
+				, data_( data )
+				, restarts_( restarts )
+				, num_restarts_( num_restarts )
+				, hash_index_( hash_index )
+				, current_( restarts_ )
+				, restart_index_( num_restarts_ ) {
+			assert( num_restarts_ > 0 );
+		}
+
+	public:
+		bool   valid() const override { return current_ < restarts_; }
+		status get_status() const override { return status_; }
+		slice  key() const override {
+			assert( valid() );
+			return key_;
+		}
+		slice value() const override {
+			assert( valid() );
+			return value_;
+		}
+
+		void next() override {
+			assert( valid() );
+			parse_next_key();
+		}
+
+		void prev() override {
+			assert( valid() );
+
+			// Scan backwards to a restart point before current_
+			const uint32_t original = current_;
+			while ( get_restart_point( restart_index_ ) >= original ) {
+				if ( restart_index_ == 0 ) {
+					// No more entries
+					current_       = restarts_;
+					restart_index_ = num_restarts_;
+					return;
+				}
+				restart_index_--;
+			}
+
+			seek_to_restart_point( restart_index_ );
+			do {
+				// Loop until end of current entry hits the start of original entry
+			} while ( parse_next_key() && next_entry_offset() < original );
+		}
+
+		void seek( const slice& target ) override {
+			// Binary search in restart array to find the last restart point
+			// with a key < target
+			uint32_t left                = 0;
+			uint32_t right               = num_restarts_ - 1;
+			int32_t  current_key_compare = 0;
+
+			if ( valid() ) {
+				// If we're already scanning, use the current position as a starting
+				// point. This is beneficial if the key we're seeking to is ahead of the
+				// current position.
+				current_key_compare = compare( key_, target );
+				if ( current_key_compare < 0 ) {
+					// key_ is smaller than target
+					left = restart_index_;
+				} else if ( current_key_compare > 0 ) {
+					right = restart_index_;
+				} else {
+					// We're seeking to the key we're already at.
+					return;
+				}
+			}
+
+			while ( left < right ) {
+				uint32_t    mid           = ( left + right + 1 ) / 2;
+				uint32_t    region_offset = get_restart_point( mid );
+				uint32_t    shared, non_shared, value_length;
+				const char* key_ptr =
+					decode_entry( data_ + region_offset, data_ + restarts_, &shared,
+												&non_shared, &value_length );
+				if ( key_ptr == nullptr || ( shared != 0 ) ) {
+					corruption_error();
+					return;
+				}
+				slice mid_key( key_ptr, non_shared );
+				if ( compare( mid_key, target ) < 0 ) {
+					// Key at "mid" is smaller than "target".  Therefore all
+					// blocks before "mid" are uninteresting.
+					left = mid;
+				} else {
+					// Key at "mid" is >= "target".  Therefore all blocks at or
+					// after "mid" are uninteresting.
+					right = mid - 1;
+				}
+			}
+
+			// We might be able to use our current position within the restart block.
+			// This is true if we determined the key we desire is in the current block
+			// and is after than the current key.
+			assert( current_key_compare == 0 || valid() );
+			bool skip_seek = left == restart_index_ && current_key_compare < 0;
+			if ( !skip_seek ) {
+				seek_to_restart_point( left );
+			}
+			// Linear search (within restart block) for first key >= target
+			while ( true ) {
+				if ( !parse_next_key() ) {
+					return;
+				}
+				if ( compare( key_, target ) >= 0 ) {
+					return;
+				}
+			}
+		}
+
+		// Position at the first entry >= target, or at none if the hash index
+		// shows the block has no entry for the user key of "target".
+		void seek_for_get( const slice& target ) {
+			if ( hash_index_ == nullptr ) {
+				seek( target );
+				return;
+			}
+
+			const uint8_t entry = hash_index_->lookup( extract_user_key( target ) );
+			if ( entry == kCollision ) {
+				seek( target );
+				return;
+			}
+			if ( entry == kNoEntry ) {
+				current_       = restarts_;
+				restart_index_ = num_restarts_;
+				return;
+			}
+			if ( entry >= num_restarts_ ) {
+				corruption_error();
+				return;
+			}
+
+			// Every version of the user key lives in this restart interval, so
+			// a linear scan from its start finds the first entry >= target.
+			seek_to_restart_point( entry );
+			while ( parse_next_key() && compare( key_, target ) < 0 ) {
+				// Keep skipping
+			}
+		}
+
+		void seek_to_first() override {
+			seek_to_restart_point( 0 );
+			parse_next_key();
+		}
+
+		void seek_to_last() override {
+			seek_to_restart_point( num_restarts_ - 1 );
+			while ( parse_next_key() && next_entry_offset() < restarts_ ) {
+				// Keep skipping
+			}
+		}
+
+	private:
+		inline int32_t compare( const slice& a, const slice& b ) const {
+			return comparator_->compare( a, b );
+		}
+
+		// Return the offset in data_ just past the end of the current entry.
+		inline uint32_t next_entry_offset() const {
+			return static_cast< uint32_t >( ( value_.data() + value_.size() ) - data_ );
+		}
+
+		uint32_t get_restart_point( uint32_t index ) const {
+			assert( index < num_restarts_ );
+			return decode_fixed32( data_ + restarts_ + index * sizeof( uint32_t ) );
+		}
+
+		void seek_to_restart_point( uint32_t index ) {
+			key_.clear();
+			restart_index_ = index;
+			// current_ will be fixed by parse_next_key();
+
+			// parse_next_key() starts at the end of value_, so set value_ accordingly
+			uint32_t offset = get_restart_point( index );
+			value_          = slice( data_ + offset, 0 );
+		}
+
+		void corruption_error() {
+			current_       = restarts_;
+			restart_index_ = num_restarts_;
+			status_        = status::corruption( "bad entry in block" );
+			key_.clear();
+			value_.clear();
+		}
+
+		bool parse_next_key() {
+			current_          = next_entry_offset();
+			const char* p     = data_ + current_;
+			const char* limit = data_ + restarts_;// Restarts come right after data
+			if ( p >= limit ) {
+				// No more entries to return.  Mark as invalid.
+				current_       = restarts_;
+				restart_index_ = num_restarts_;
+				return false;
+			}
+
+			// Decode next entry
+			uint32_t shared, non_shared, value_length;
+			p = decode_entry( p, limit, &shared, &non_shared, &value_length );
+			if ( p == nullptr || key_.size() < shared ) {
+				corruption_error();
+				return false;
+			} else {
+				key_.resize( shared );
+				key_.append( p, non_shared );
+				value_ = slice( p + non_shared, value_length );
+				while ( restart_index_ + 1 < num_restarts_ &&
+								get_restart_point( restart_index_ + 1 ) < current_ ) {
+					++restart_index_;
+				}
+				return true;
+			}
+		}
+	};
+
+	iterator* block::new_iterator( const comparator* comparator ) {
+		if ( size_ < sizeof( uint32_t ) ) {
+			return new_error_iterator( status::corruption( "bad block contents" ) );
+		}
+		if ( num_restarts_ == 0 ) {
+			return new_empty_iterator();
+		} else {
+			return new iter( comparator, data_, restart_offset_, num_restarts_,
+											 has_hash_index_ ? &hash_index_ : nullptr );
+		}
+	}
+
+	iterator* block::new_iterator_for_get( const comparator* comparator, const slice& target ) {
+		if ( size_ < sizeof( uint32_t ) ) {
+			return new_error_iterator( status::corruption( "bad block contents" ) );
+		}
+		if ( num_restarts_ == 0 ) {
+			return new_empty_iterator();
+		}
+		iter* result = new iter( comparator, data_, restart_offset_, num_restarts_,
+														 has_hash_index_ ? &hash_index_ : nullptr );
+		result->seek_for_get( target );
+		return result;
+	}
+
+	static void delete_cached_block( const slice& key, void* value ) {
+		block* b = reinterpret_cast< block* >( value );
+		delete b;
+	}
+
+	static slice cached_block_contents( void* value ) {
+		return reinterpret_cast< block* >( value )->data();
+	}
+
+	static void* create_cached_block( const slice& contents, size_t* charge ) {
+		char* buf = new char[ contents.size() ];
+		std::memcpy( buf, contents.data(), contents.size() );
+		block* b = new block( block_contents{ slice( buf, contents.size() ), true, true } );
+		*charge  = b->size();
+		return b;
+	}
+
+	static const cache::item_helper kCachedBlockHelper = {
+		&delete_cached_block,
+		&cached_block_contents,
+		&create_cached_block,
+	};
+
+	status fetch_block( const options& options, const read_options& read_options,
+											random_access_file* file, uint64_t cache_id, const block_handle& handle,
+											block** result, cache::handle** cache_handle, cache::block_type type ) {
+		cache*         block_cache = options.block_cache;
+		block_contents contents;
+		status         s;
+
+		*result       = nullptr;
+		*cache_handle = nullptr;
+		if ( block_cache != nullptr && cache_id != 0 ) {
+			char cache_key_buffer[ 16 ];
+			encode_fixed64( cache_key_buffer, cache_id );
+			encode_fixed64( cache_key_buffer + 8, handle.offset() );
+			slice key( cache_key_buffer, sizeof( cache_key_buffer ) );
+			*cache_handle = block_cache->look_up_item( key, &kCachedBlockHelper );
+			block_cache->record_block_look_up( type, *cache_handle != nullptr );
+			if ( *cache_handle != nullptr ) {
+				*result = reinterpret_cast< block* >( block_cache->value( *cache_handle ) );
+			} else {
+				s = read_block( file, read_options, handle, &contents );
+				if ( s.is_ok() ) {
+					*result = new block( contents );
+					if ( contents.cachable && read_options.fill_cache ) {
+						const cache::priority priority =
+							type == cache::block_type::kData ? cache::priority::kLow : cache::priority::kHigh;
+						*cache_handle = block_cache->insert_item( key, *result, ( *result )->size(),
+																											&kCachedBlockHelper, priority );
+						block_cache->record_block_insert( type );
+					}
+				}
+			}
+		} else {
+			s = read_block( file, read_options, handle, &contents );
+			if ( s.is_ok() ) {
+				*result = new block( contents );
+			}
+		}
+		return s;
+	}
+
+	// Unpin "b" when "iter" is deleted.
+	static void register_block_cleanup( iterator* iter, cache* block_cache, block* b,
+																			cache::handle* cache_handle ) {
+		if ( cache_handle == nullptr ) {
+			iter->register_cleanup( [ b ]() { delete b; } );
+		} else {
+			iter->register_cleanup( [ block_cache, cache_handle ]() { block_cache->release( cache_handle ); } );
+		}
+	}
+
+	iterator* new_block_iterator( const options& options, const read_options& read_options,
+																random_access_file* file, uint64_t cache_id,
+																const block_handle& handle, cache::block_type type ) {
+		block*         b            = nullptr;
+		cache::handle* cache_handle = nullptr;
+		status         s            = fetch_block( options, read_options, file, cache_id, handle,
+																							 &b, &cache_handle, type );
+		if ( !s.is_ok() ) {
+			return new_error_iterator( s );
+		}
+
+		iterator* iter = b->new_iterator( options.comparator );
+		register_block_cleanup( iter, options.block_cache, b, cache_handle );
+		return iter;
+	}
+
+	iterator* new_block_iterator_for_get( const options& options, const read_options& read_options,
+																				random_access_file* file, uint64_t cache_id,
+																				const block_handle& handle, const slice& target ) {
+		block*         b            = nullptr;
+		cache::handle* cache_handle = nullptr;
+		status         s            = fetch_block( options, read_options, file, cache_id, handle,
+																							 &b, &cache_handle );
+		if ( !s.is_ok() ) {
+			return new_error_iterator( s );
+		}
+
+		iterator* iter = b->new_iterator_for_get( options.comparator, target );
+		register_block_cleanup( iter, options.block_cache, b, cache_handle );
+		return iter;
+	}
+
+}// namespace simple_leveldb
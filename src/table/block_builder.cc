@@ -0,0 +1,130 @@
+// block_builder generates blocks where keys are prefix-compressed:
+//
+// When we store a key, we drop the prefix shared with the previous
+// string.  This helps reduce the space requirement significantly.
+// Furthermore, once every K keys, we do not apply the prefix
+// compression and store the entire key.  We call this a "restart
+// point".  The tail end of the block stores the offsets of all of the
+// restart points, and can be used to do a binary search when looking
+// for a particular key.  Values are stored as-is (without compression)
+// immediately following the corresponding key.
+//
+// An entry for a particular key-value pair has the form:
+//     shared_bytes: varint32
+//     unshared_bytes: varint32
+//     value_length: varint32
+//     key_delta: char[unshared_bytes]
+//     value: char[value_length]
+// shared_bytes == 0 for restart points.
+//
+// The trailer of the block has the form:
+//     restarts: uint32[num_restarts]
+//     hash_index: data_block_hash_index (optional)
+//     num_restarts: uint32
+// restarts[i] contains the offset within the block of the ith restart point.
+// The top bit of num_restarts is set iff the hash index is present.
+
+#include "table/block_builder.h"
+#include "leveldb/comparator.h"
+#include "leveldb/options.h"
+#include "leveldb/__detail/db_format.h"
+#include "leveldb/slice.h"
+#include "table/data_block_hash_index.h"
+#include "util/coding.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	block_builder::block_builder( const options* options, bool use_hash_index )
+			: options_( options )
+			, restarts_()
+			, counter_( 0 )
+			, finished_( false )
+			, use_hash_index_( use_hash_index ) {
+		assert( options->block_restart_interval >= 1 );
+		restarts_.push_back( 0 );// First restart point is at offset 0
+		if ( use_hash_index_ ) {
+			hash_index_builder_.initialize( options->data_block_hash_table_util_ratio );
+		}
+	}
+
+	void block_builder::reset() {
+		buffer_.clear();
+		restarts_.clear();
+		restarts_.push_back( 0 );// First restart point is at offset 0
+		counter_  = 0;
+		finished_ = false;
+		last_key_.clear();
+		if ( use_hash_index_ ) {
+			hash_index_builder_.reset();
+		}
+	}
+
+	size_t block_builder::current_size_estimate() const {
+		size_t estimate = ( buffer_.size() +                       // Raw data buffer
+												restarts_.size() * sizeof( uint32_t ) +// Restart array
+												sizeof( uint32_t ) );                  // Restart array length
+		if ( use_hash_index_ && hash_index_builder_.valid() ) {
+			estimate += hash_index_builder_.estimate_size();
+		}
+		return estimate;
+	}
+
+	slice block_builder::finish() {
+		// Append restart array
+		for ( auto restart: restarts_ ) {
+			put_fixed32( &buffer_, restart );
+		}
+		uint32_t num_restarts = static_cast< uint32_t >( restarts_.size() );
+		if ( use_hash_index_ && hash_index_builder_.valid() ) {
+			hash_index_builder_.finish( buffer_ );
+			num_restarts |= kDataBlockHashIndexFlag;
+		}
+		put_fixed32( &buffer_, num_restarts );
+		finished_ = true;
+		return slice( buffer_ );
+	}
+
+	void block_builder::add( const slice& key, const slice& value ) {
+		slice last_key_piece( last_key_ );
+		assert( !finished_ );
+		assert( counter_ <= options_->block_restart_interval );
+		assert( buffer_.empty()// No values yet?
+						|| options_->comparator->compare( key, last_key_piece ) > 0 );
+		size_t shared = 0;
+		if ( counter_ < options_->block_restart_interval ) {
+			// See how much sharing to do with previous string
+			const size_t min_length = core::min( last_key_piece.size(), key.size() );
+			while ( ( shared < min_length ) && ( last_key_piece[ shared ] == key[ shared ] ) ) {
+				shared++;
+			}
+		} else {
+			// Restart compression
+			restarts_.push_back( static_cast< uint32_t >( buffer_.size() ) );
+			counter_ = 0;
+		}
+		const size_t non_shared = key.size() - shared;
+
+		// Add "<shared><non_shared><value_size>" to buffer_
+		put_varint32( &buffer_, static_cast< uint32_t >( shared ) );
+		put_varint32( &buffer_, static_cast< uint32_t >( non_shared ) );
+		put_varint32( &buffer_, static_cast< uint32_t >( value.size() ) );
+
+		// Add string delta to buffer_ followed by value
+		buffer_.append( key.data() + shared, non_shared );
+		buffer_.append( value.data(), value.size() );
+
+		// Update state
+		last_key_.resize( shared );
+		last_key_.append( key.data() + shared, non_shared );
+		assert( slice( last_key_ ) == key );
+		counter_++;
+
+		if ( use_hash_index_ && hash_index_builder_.valid() ) {
+			hash_index_builder_.add( extract_user_key( key ), restarts_.size() - 1 );
+		}
+	}
+
+}// namespace simple_leveldb
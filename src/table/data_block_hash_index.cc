@@ -0,0 +1,93 @@
+#include "table/data_block_hash_index.h"
+#include "leveldb/slice.h"
+#include "util/hash.h"
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	static const uint32_t kSeed = 0x6b9083d9;
+
+	static inline uint32_t hash_user_key( const slice& user_key ) {
+		return Hash( user_key.data(), user_key.size(), kSeed );
+	}
+
+	void data_block_hash_index_builder::initialize( double util_ratio ) {
+		if ( util_ratio <= 0 ) {
+			util_ratio = 0.75;// sanity check
+		}
+		bucket_per_key_ = 1 / util_ratio;
+		valid_          = true;
+	}
+
+	void data_block_hash_index_builder::add( const slice& user_key, size_t restart_index ) {
+		assert( valid() );
+		if ( restart_index > kMaxRestartSupportedByHashIndex ) {
+			valid_ = false;
+			return;
+		}
+		hash_and_restart_pairs_.emplace_back( hash_user_key( user_key ),
+																					static_cast< uint8_t >( restart_index ) );
+		estimated_num_buckets_ += bucket_per_key_;
+	}
+
+	static uint16_t num_buckets_for( double estimated_num_buckets ) {
+		const double n           = core::min( estimated_num_buckets, static_cast< double >( UINT16_MAX - 1 ) );
+		uint16_t     num_buckets = static_cast< uint16_t >( n );
+		if ( num_buckets == 0 ) {
+			num_buckets = 1;
+		}
+		// An odd number of buckets spreads hashes that share low bits.
+		return num_buckets | 1;
+	}
+
+	void data_block_hash_index_builder::finish( core::string& buffer ) {
+		assert( valid() );
+		const uint16_t          num_buckets = num_buckets_for( estimated_num_buckets_ );
+		core::vector< uint8_t > buckets( num_buckets, kNoEntry );
+		for ( const auto& [ hash, restart_index ]: hash_and_restart_pairs_ ) {
+			uint8_t& entry = buckets[ hash % num_buckets ];
+			if ( entry == kNoEntry ) {
+				entry = restart_index;
+			} else if ( entry != restart_index ) {
+				entry = kCollision;
+			}
+		}
+		buffer.append( reinterpret_cast< const char* >( buckets.data() ), num_buckets );
+		buffer.push_back( static_cast< char >( num_buckets & 0xff ) );
+		buffer.push_back( static_cast< char >( num_buckets >> 8 ) );
+	}
+
+	void data_block_hash_index_builder::reset() {
+		estimated_num_buckets_ = 0;
+		valid_                 = true;
+		hash_and_restart_pairs_.clear();
+	}
+
+	size_t data_block_hash_index_builder::estimate_size() const {
+		return num_buckets_for( estimated_num_buckets_ ) + sizeof( uint16_t );
+	}
+
+	bool data_block_hash_index::initialize( const char* data, size_t size, size_t* map_offset ) {
+		if ( size < sizeof( uint16_t ) ) {
+			return false;
+		}
+		const uint8_t* p = reinterpret_cast< const uint8_t* >( data + size - sizeof( uint16_t ) );
+		num_buckets_     = static_cast< uint16_t >( p[ 0 ] | ( p[ 1 ] << 8 ) );
+		if ( num_buckets_ == 0 || num_buckets_ > size - sizeof( uint16_t ) ) {
+			return false;
+		}
+		*map_offset = size - sizeof( uint16_t ) - num_buckets_;
+		buckets_    = data + *map_offset;
+		return true;
+	}
+
+	uint8_t data_block_hash_index::lookup( const slice& user_key ) const {
+		assert( num_buckets_ > 0 );
+		return static_cast< uint8_t >( buckets_[ hash_user_key( user_key ) % num_buckets_ ] );
+	}
+
+}// namespace simple_leveldb
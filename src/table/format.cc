@@ -0,0 +1,143 @@
+#include "table/format.h"
+#include "leveldb/env.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	void block_handle::encode_to( core::string* dst ) const {
+		// Sanity check that all fields have been set
+		assert( offset_ != ~static_cast< uint64_t >( 0 ) );
+		assert( size_ != ~static_cast< uint64_t >( 0 ) );
+		put_varint64( dst, offset_ );
+		put_varint64( dst, size_ );
+	}
+
+	status block_handle::decode_from( slice* input ) {
+		if ( get_varint64( input, &offset_ ) && get_varint64( input, &size_ ) ) {
+			return status::ok();
+		}
+		return status::corruption( "bad block handle" );
+	}
+
+	void footer::encode_to( core::string* dst ) const {
+		const size_t original_size = dst->size();
+		metaindex_handle_.encode_to( dst );
+		index_handle_.encode_to( dst );
+		dst->resize( original_size + 2 * block_handle::kMaxEncodedLength );// Padding
+		put_fixed32( dst, static_cast< uint32_t >( kTableMagicNumber & 0xffffffffu ) );
+		put_fixed32( dst, static_cast< uint32_t >( kTableMagicNumber >> 32 ) );
+		assert( dst->size() == original_size + kEncodedLength );
+		(void) original_size;// Disable unused variable warning.
+	}
+
+	status footer::decode_from( slice* input ) {
+		if ( input->size() < kEncodedLength ) {
+			return status::corruption( "not an sstable (footer too short)" );
+		}
+
+		const char*    magic_ptr = input->data() + kEncodedLength - 8;
+		const uint32_t magic_lo  = decode_fixed32( magic_ptr );
+		const uint32_t magic_hi  = decode_fixed32( magic_ptr + 4 );
+		const uint64_t magic     = ( ( static_cast< uint64_t >( magic_hi ) << 32 ) |
+															 ( static_cast< uint64_t >( magic_lo ) ) );
+		if ( magic != kTableMagicNumber ) {
+			return status::corruption( "not an sstable (bad magic number)" );
+		}
+
+		status result = metaindex_handle_.decode_from( input );
+		if ( result.is_ok() ) {
+			result = index_handle_.decode_from( input );
+		}
+		if ( result.is_ok() ) {
+			// We skip over any leftover data (just padding for now) in "input"
+			const char* end = magic_ptr + 8;
+			*input          = slice( end, input->data() + input->size() - end );
+		}
+		return result;
+	}
+
+	status read_block( random_access_file* file, const read_options& options,
+										 const block_handle& handle, block_contents* result ) {
+		result->data           = slice();
+		result->cachable       = false;
+		result->heap_allocated = false;
+
+		// Read the block contents as well as the type/crc footer.
+		// See table_builder.cc for the code that built this structure.
+		// Files that read in place (mmap) return pointers into their own
+		// memory, so there is no need for a scratch buffer.
+		size_t n   = static_cast< size_t >( handle.size() );
+		char*  buf = file->reads_in_place() ? nullptr : new char[ n + kBlockTrailerSize ];
+		slice  contents;
+		status s = file->read( handle.offset(), n + kBlockTrailerSize, &contents, buf );
+		if ( !s.is_ok() ) {
+			delete[] buf;
+			return s;
+		}
+		if ( contents.size() != n + kBlockTrailerSize ) {
+			delete[] buf;
+			return status::corruption( "truncated block read" );
+		}
+
+		// Check the crc of the type and the block contents
+		const char* data = contents.data();// Pointer to where Read put the data
+		if ( options.verify_checksums ) {
+			const uint32_t crc    = crc32c::Unmask( decode_fixed32( data + n + 1 ) );
+			const uint32_t actual = crc32c::Value( data, n + 1 );
+			if ( actual != crc ) {
+				delete[] buf;
+				return status::corruption( "block checksum mismatch" );
+			}
+		}
+
+		switch ( static_cast< compression_type >( data[ n ] ) ) {
+			case compression_type::kNoCompression:
+				if ( data != buf ) {
+					// File implementation gave us pointer to some other data.
+					// Use it directly under the assumption that it will be live
+					// while the file is open.
+					delete[] buf;
+					result->data           = slice( data, n );
+					result->heap_allocated = false;
+					result->cachable       = false;// Do not double-cache
+				} else {
+					result->data           = slice( buf, n );
+					result->heap_allocated = true;
+					result->cachable       = true;
+				}
+				// Ok
+				break;
+			default:
+				delete[] buf;
+				return status::corruption( "bad block type" );
+		}
+
+		return status::ok();
+	}
+
+	status write_raw_block( writable_file* file, const slice& contents, compression_type type,
+													uint64_t* offset, block_handle* handle ) {
+		handle->set_offset( *offset );
+		handle->set_size( contents.size() );
+		status s = file->append( contents );
+		if ( s.is_ok() ) {
+			char trailer[ kBlockTrailerSize ];
+			trailer[ 0 ]  = static_cast< char >( type );
+			uint32_t crc  = crc32c::Value( contents.data(), contents.size() );
+			crc           = crc32c::Extend( crc, trailer, 1 );// Extend crc to cover block type
+			encode_fixed32( trailer + 1, crc32c::Mask( crc ) );
+			s = file->append( slice( trailer, kBlockTrailerSize ) );
+			if ( s.is_ok() ) {
+				*offset += contents.size() + kBlockTrailerSize;
+			}
+		}
+		return s;
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,173 @@
+#include "table/index_builder.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace simple_leveldb {
+
+	static options make_index_block_options( const options* opt ) {
+		options result                = *opt;
+		result.block_restart_interval = 1;
+		return result;
+	}
+
+	index_builder::index_builder( const options* options )
+			: options_( options )
+			, index_block_options_( make_index_block_options( options ) )
+			, partitioned_( options->partition_index_and_filters )
+			, index_block_( &index_block_options_ )
+			, index_size_( 0 )
+			, filter_size_( 0 ) {}
+
+	index_type index_builder::type() const {
+		return partitioned_ ? index_type::kTwoLevelIndexSearch : index_type::kBinarySearch;
+	}
+
+	void index_builder::add_key( const slice& key ) {
+		if ( options_->filter_policy == nullptr ) {
+			return;
+		}
+		start_.push_back( keys_.size() );
+		keys_.append( key.data(), key.size() );
+	}
+
+	void index_builder::add_index_entry( core::string* last_key_in_current_block,
+																			 const slice* first_key_in_next_block,
+																			 const block_handle& handle ) {
+		if ( first_key_in_next_block != nullptr ) {
+			options_->comparator->find_shortest_separator( last_key_in_current_block,
+																										 *first_key_in_next_block );
+		} else {
+			options_->comparator->find_short_successor( last_key_in_current_block );
+		}
+
+		core::string handle_encoding;
+		handle.encode_to( &handle_encoding );
+		index_block_.add( *last_key_in_current_block, handle_encoding );
+		last_separator_ = *last_key_in_current_block;
+
+		if ( partitioned_ &&
+				 index_block_.current_size_estimate() >= options_->metadata_block_size ) {
+			cut_partition();
+		}
+	}
+
+	void index_builder::cut_partition() {
+		assert( partitioned_ );
+		assert( !index_block_.empty() );
+		partition p;
+		p.separator = last_separator_;
+		p.index     = index_block_.finish().to_string();
+		index_block_.reset();
+		if ( options_->filter_policy != nullptr ) {
+			p.filter = generate_filter();
+		}
+		partitions_.emplace_back( core::move( p ) );
+	}
+
+	core::string index_builder::generate_filter() {
+		core::string result;
+		const size_t num_keys = start_.size();
+		if ( num_keys == 0 ) {
+			return result;
+		}
+
+		// Make list of keys from flattened key structure
+		start_.push_back( keys_.size() );// Simplify length computation
+		tmp_keys_.resize( num_keys );
+		for ( size_t i = 0; i < num_keys; i++ ) {
+			const char* base   = keys_.data() + start_[ i ];
+			size_t      length = start_[ i + 1 ] - start_[ i ];
+			tmp_keys_[ i ]     = slice( base, length );
+		}
+		options_->filter_policy->create_filter( &tmp_keys_[ 0 ], static_cast< int32_t >( num_keys ), result );
+
+		tmp_keys_.clear();
+		keys_.clear();
+		start_.clear();
+		return result;
+	}
+
+	status index_builder::write_index_block( writable_file* file, const slice& contents,
+																					 uint64_t* offset, block_handle* handle ) {
+		status s = write_raw_block( file, contents, compression_type::kNoCompression, offset, handle );
+		if ( s.is_ok() ) {
+			index_size_ += handle->size() + kBlockTrailerSize;
+		}
+		return s;
+	}
+
+	status index_builder::write_filter_block( writable_file* file, const slice& contents,
+																						uint64_t* offset, block_handle* handle ) {
+		status s = write_raw_block( file, contents, compression_type::kNoCompression, offset, handle );
+		if ( s.is_ok() ) {
+			filter_size_ += handle->size() + kBlockTrailerSize;
+		}
+		return s;
+	}
+
+	status index_builder::finish( writable_file* file, uint64_t* offset, block_handle* index_handle,
+																block_handle* filter_handle ) {
+		status s;
+		filter_handle->set_offset( 0 );
+		filter_handle->set_size( 0 );
+
+		if ( !partitioned_ ) {
+			if ( options_->filter_policy != nullptr ) {
+				s = write_filter_block( file, generate_filter(), offset, filter_handle );
+			}
+			if ( s.is_ok() ) {
+				s = write_index_block( file, index_block_.finish(), offset, index_handle );
+			}
+			return s;
+		}
+
+		if ( !index_block_.empty() ) {
+			cut_partition();
+		}
+
+		block_builder top_level_index( &index_block_options_ );
+		block_builder top_level_filter( &index_block_options_ );
+		core::string  handle_encoding;
+		for ( const auto& p: partitions_ ) {
+			block_handle handle;
+			if ( options_->filter_policy != nullptr ) {
+				s = write_filter_block( file, p.filter, offset, &handle );
+				if ( !s.is_ok() ) {
+					return s;
+				}
+				handle_encoding.clear();
+				handle.encode_to( &handle_encoding );
+				top_level_filter.add( p.separator, handle_encoding );
+			}
+
+			s = write_index_block( file, p.index, offset, &handle );
+			if ( !s.is_ok() ) {
+				return s;
+			}
+			handle_encoding.clear();
+			handle.encode_to( &handle_encoding );
+			top_level_index.add( p.separator, handle_encoding );
+		}
+		partitions_.clear();
+
+		if ( options_->filter_policy != nullptr ) {
+			s = write_filter_block( file, top_level_filter.finish(), offset, filter_handle );
+		}
+		if ( s.is_ok() ) {
+			s = write_index_block( file, top_level_index.finish(), offset, index_handle );
+		}
+		return s;
+	}
+
+}// namespace simple_leveldb
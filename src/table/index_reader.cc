@@ -0,0 +1,226 @@
+#include "table/index_reader.h"
+#include "leveldb/cache.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/block.h"
+#include "table/format.h"
+#include "table/two_level_iterator.h"
+#include "util/coding.h"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace simple_leveldb {
+
+	index_reader::index_reader( const options& options, random_access_file* file, uint64_t cache_id,
+															index_type type )
+			: options_( options )
+			, file_( file )
+			, cache_id_( cache_id )
+			, type_( type )
+			, index_block_( nullptr )
+			, filter_index_( nullptr ) {
+		filter_.data           = slice();
+		filter_.cachable       = false;
+		filter_.heap_allocated = false;
+	}
+
+	index_reader::~index_reader() {
+		delete index_block_;
+		delete filter_index_;
+		if ( filter_.heap_allocated ) {
+			delete[] filter_.data.data();
+		}
+	}
+
+	status index_reader::open( const options& options, random_access_file* file, uint64_t cache_id,
+														 index_type type, const block_handle& index_handle,
+														 const block_handle& filter_handle, index_reader** reader ) {
+		*reader = nullptr;
+
+		read_options opt;
+		if ( options.paranoid_checks ) {
+			opt.verify_checksums = true;
+		}
+		block_contents index_contents;
+		status         s = read_block( file, opt, index_handle, &index_contents );
+		if ( !s.is_ok() ) {
+			return s;
+		}
+
+		index_reader* r = new index_reader( options, file, cache_id, type );
+		r->index_block_ = new block( index_contents );
+
+		if ( options.filter_policy != nullptr && filter_handle.size() > 0 ) {
+			// A missing or corrupt filter only costs us the ability to skip
+			// reads, so errors here are not propagated.
+			block_contents filter_contents;
+			if ( read_block( file, opt, filter_handle, &filter_contents ).is_ok() ) {
+				if ( type == index_type::kTwoLevelIndexSearch ) {
+					r->filter_index_ = new block( filter_contents );
+				} else {
+					r->filter_ = filter_contents;
+				}
+			}
+		}
+
+		*reader = r;
+		return s;
+	}
+
+	status index_reader::find_data_block( const read_options& read_options, const slice& key,
+																				block_handle* handle ) {
+		iterator* iiter = index_block_->new_iterator( options_.comparator );
+		iiter->seek( key );
+		status s;
+		if ( !iiter->valid() ) {
+			s = iiter->get_status();
+			if ( s.is_ok() ) {
+				s = status::not_found( "key past the end of the table" );
+			}
+		} else if ( type_ == index_type::kBinarySearch ) {
+			slice input = iiter->value();
+			s           = handle->decode_from( &input );
+		} else {
+			block_handle partition_handle;
+			slice        input = iiter->value();
+			s                  = partition_handle.decode_from( &input );
+			if ( s.is_ok() ) {
+				iterator* piter = new_block_iterator( options_, read_options, file_, cache_id_,
+																							partition_handle, cache::block_type::kIndex );
+				piter->seek( key );
+				if ( piter->valid() ) {
+					input = piter->value();
+					s     = handle->decode_from( &input );
+				} else {
+					s = piter->get_status();
+					if ( s.is_ok() ) {
+						s = status::corruption( "index partition does not cover its separator" );
+					}
+				}
+				delete piter;
+			}
+		}
+		delete iiter;
+		return s;
+	}
+
+	iterator* index_reader::new_index_iterator( const read_options& read_options ) {
+		iterator* iiter = index_block_->new_iterator( options_.comparator );
+		if ( type_ == index_type::kBinarySearch ) {
+			return iiter;
+		}
+		return new_two_level_iterator( iiter, [ this, read_options ]( const slice& index_value ) {
+			block_handle partition_handle;
+			slice        input = index_value;
+			status       s     = partition_handle.decode_from( &input );
+			if ( !s.is_ok() ) {
+				return new_error_iterator( s );
+			}
+			return new_block_iterator( options_, read_options, file_, cache_id_, partition_handle,
+																 cache::block_type::kIndex );
+		} );
+	}
+
+	bool index_reader::key_may_match( const read_options& read_options, const slice& key ) {
+		const filter_policy* policy = options_.filter_policy;
+		if ( policy == nullptr ) {
+			return true;
+		}
+		if ( type_ == index_type::kBinarySearch ) {
+			return filter_.data.empty() || policy->key_may_match( key, filter_.data );
+		}
+		if ( filter_index_ == nullptr ) {
+			return true;
+		}
+
+		bool      may_match = true;
+		iterator* iter      = filter_index_->new_iterator( options_.comparator );
+		iter->seek( key );
+		if ( iter->valid() ) {
+			block_handle handle;
+			slice        input = iter->value();
+			if ( handle.decode_from( &input ).is_ok() ) {
+				may_match = partition_may_match( read_options, handle, key );
+			}
+		} else if ( iter->get_status().is_ok() ) {
+			// Past the last separator, so past every key of the table.
+			may_match = false;
+		}
+		delete iter;
+		return may_match;
+	}
+
+	static void delete_cached_filter( const slice& key, void* value ) {
+		block_contents* contents = reinterpret_cast< block_contents* >( value );
+		if ( contents->heap_allocated ) {
+			delete[] contents->data.data();
+		}
+		delete contents;
+	}
+
+	static slice cached_filter_contents( void* value ) {
+		return reinterpret_cast< block_contents* >( value )->data;
+	}
+
+	static void* create_cached_filter( const slice& contents, size_t* charge ) {
+		char* buf = new char[ contents.size() ];
+		std::memcpy( buf, contents.data(), contents.size() );
+		*charge = contents.size();
+		return new block_contents{ slice( buf, contents.size() ), true, true };
+	}
+
+	static const cache::item_helper kCachedFilterHelper = {
+		&delete_cached_filter,
+		&cached_filter_contents,
+		&create_cached_filter,
+	};
+
+	bool index_reader::partition_may_match( const read_options& read_options,
+																					const block_handle& handle, const slice& key ) {
+		cache* const block_cache = options_.block_cache;
+		const bool   use_cache   = ( block_cache != nullptr && cache_id_ != 0 );
+		char         cache_key_buffer[ 16 ];
+		encode_fixed64( cache_key_buffer, cache_id_ );
+		encode_fixed64( cache_key_buffer + 8, handle.offset() );
+		const slice cache_key( cache_key_buffer, sizeof( cache_key_buffer ) );
+
+		if ( use_cache ) {
+			cache::handle* cache_handle = block_cache->look_up_item( cache_key, &kCachedFilterHelper );
+			block_cache->record_block_look_up( cache::block_type::kFilter, cache_handle != nullptr );
+			if ( cache_handle != nullptr ) {
+				const block_contents* contents =
+					reinterpret_cast< block_contents* >( block_cache->value( cache_handle ) );
+				const bool may_match = options_.filter_policy->key_may_match( key, contents->data );
+				block_cache->release( cache_handle );
+				return may_match;
+			}
+		}
+
+		block_contents contents;
+		if ( !read_block( file_, read_options, handle, &contents ).is_ok() ) {
+			return true;
+		}
+		const bool may_match = options_.filter_policy->key_may_match( key, contents.data );
+		if ( use_cache && contents.cachable && read_options.fill_cache ) {
+			block_cache->release( block_cache->insert_item( cache_key, new block_contents( contents ),
+																											contents.data.size(), &kCachedFilterHelper,
+																											cache::priority::kHigh ) );
+			block_cache->record_block_insert( cache::block_type::kFilter );
+		} else if ( contents.heap_allocated ) {
+			delete[] contents.data.data();
+		}
+		return may_match;
+	}
+
+	size_t index_reader::pinned_memory_usage() const {
+		size_t usage = index_block_->size() + filter_.data.size();
+		if ( filter_index_ != nullptr ) {
+			usage += filter_index_->size();
+		}
+		return usage;
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,56 @@
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <cassert>
+#include <functional>
+#include <utility>
+
+namespace simple_leveldb {
+
+	iterator::~iterator() {
+		for ( auto& cleanup: cleanups_ ) {
+			cleanup();
+		}
+	}
+
+	void iterator::register_cleanup( core::function< void() >&& func ) {
+		assert( func != nullptr );
+		cleanups_.emplace_back( core::move( func ) );
+	}
+
+	namespace {
+
+		class empty_iterator : public iterator {
+		private:
+			status status_;
+
+		public:
+			explicit empty_iterator( const status& s )
+					: status_( s ) {}
+			~empty_iterator() override = default;
+
+		public:
+			bool   valid() const override { return false; }
+			void   seek( const slice& target ) override {}
+			void   seek_to_first() override {}
+			void   seek_to_last() override {}
+			void   next() override { assert( false ); }
+			void   prev() override { assert( false ); }
+			slice  key() const override {
+				assert( false );
+				return slice();
+			}
+			slice value() const override {
+				assert( false );
+				return slice();
+			}
+			status get_status() const override { return status_; }
+		};
+
+	}// namespace
+
+	iterator* new_empty_iterator() { return new empty_iterator( status::ok() ); }
+
+	iterator* new_error_iterator( const status& s ) { return new empty_iterator( s ); }
+
+}// namespace simple_leveldb
@@ -0,0 +1,194 @@
+#include "table/merger.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <cassert>
+#include <cstdint>
+
+namespace simple_leveldb {
+
+	namespace {
+
+		class merging_iterator : public iterator {
+		private:
+			// Which direction is the iterator moving?
+			enum class direction {
+				kForward,
+				kReverse,
+			};
+
+			// We might want to use a heap in case there are lots of children.
+			// For now we use a simple array since we expect a very small number
+			// of children in leveldb.
+			const comparator* comparator_;
+			iterator**        children_;
+			const int32_t     n_;
+			iterator*         current_;
+			direction         direction_;
+
+		public:
+			merging_iterator( const comparator* comparator, iterator** children, int32_t n )
+					: comparator_( comparator )
+					, children_( new iterator*[ n ] )
+					, n_( n )
+					, current_( nullptr )
+					, direction_( direction::kForward ) {
+				for ( int32_t i = 0; i < n; i++ ) {
+					children_[ i ] = children[ i ];
+				}
+			}
+
+			~merging_iterator() override {
+				for ( int32_t i = 0; i < n_; i++ ) {
+					delete children_[ i ];
+				}
+				delete[] children_;
+			}
+
+		public:
+			bool valid() const override { return current_ != nullptr; }
+
+			void seek_to_first() override {
+				for ( int32_t i = 0; i < n_; i++ ) {
+					children_[ i ]->seek_to_first();
+				}
+				find_smallest();
+				direction_ = direction::kForward;
+			}
+
+			void seek_to_last() override {
+				for ( int32_t i = 0; i < n_; i++ ) {
+					children_[ i ]->seek_to_last();
+				}
+				find_largest();
+				direction_ = direction::kReverse;
+			}
+
+			void seek( const slice& target ) override {
+				for ( int32_t i = 0; i < n_; i++ ) {
+					children_[ i ]->seek( target );
+				}
+				find_smallest();
+				direction_ = direction::kForward;
+			}
+
+			void next() override {
+				assert( valid() );
+
+				// Ensure that all children are positioned after key().
+				// If we are moving in the forward direction, it is already
+				// true for all of the non-current_ children since current_ is
+				// the smallest child and key() == current_->key().  Otherwise,
+				// we explicitly position the non-current_ children.
+				if ( direction_ != direction::kForward ) {
+					const core::string k = key().to_string();
+					for ( int32_t i = 0; i < n_; i++ ) {
+						iterator* child = children_[ i ];
+						if ( child != current_ ) {
+							child->seek( k );
+							if ( child->valid() && comparator_->compare( k, child->key() ) == 0 ) {
+								child->next();
+							}
+						}
+					}
+					direction_ = direction::kForward;
+				}
+
+				current_->next();
+				find_smallest();
+			}
+
+			void prev() override {
+				assert( valid() );
+
+				// Ensure that all children are positioned before key().
+				// If we are moving in the reverse direction, it is already
+				// true for all of the non-current_ children since current_ is
+				// the largest child and key() == current_->key().  Otherwise,
+				// we explicitly position the non-current_ children.
+				if ( direction_ != direction::kReverse ) {
+					const core::string k = key().to_string();
+					for ( int32_t i = 0; i < n_; i++ ) {
+						iterator* child = children_[ i ];
+						if ( child != current_ ) {
+							child->seek( k );
+							if ( child->valid() ) {
+								// Child is at first entry >= key().  Step back one to be < key()
+								child->prev();
+							} else {
+								// Child has no entries >= key().  Position at last entry.
+								child->seek_to_last();
+							}
+						}
+					}
+					direction_ = direction::kReverse;
+				}
+
+				current_->prev();
+				find_largest();
+			}
+
+			slice key() const override {
+				assert( valid() );
+				return current_->key();
+			}
+
+			slice value() const override {
+				assert( valid() );
+				return current_->value();
+			}
+
+			status get_status() const override {
+				status s;
+				for ( int32_t i = 0; i < n_; i++ ) {
+					s = children_[ i ]->get_status();
+					if ( !s.is_ok() ) {
+						break;
+					}
+				}
+				return s;
+			}
+
+		private:
+			void find_smallest() {
+				iterator* smallest = nullptr;
+				for ( int32_t i = 0; i < n_; i++ ) {
+					iterator* child = children_[ i ];
+					if ( child->valid() ) {
+						if ( smallest == nullptr || comparator_->compare( child->key(), smallest->key() ) < 0 ) {
+							smallest = child;
+						}
+					}
+				}
+				current_ = smallest;
+			}
+
+			void find_largest() {
+				iterator* largest = nullptr;
+				for ( int32_t i = n_ - 1; i >= 0; i-- ) {
+					iterator* child = children_[ i ];
+					if ( child->valid() ) {
+						if ( largest == nullptr || comparator_->compare( child->key(), largest->key() ) > 0 ) {
+							largest = child;
+						}
+					}
+				}
+				current_ = largest;
+			}
+		};
+
+	}// namespace
+
+	iterator* new_merging_iterator( const comparator* comparator, iterator** children, int32_t n ) {
+		assert( n >= 0 );
+		if ( n == 0 ) {
+			return new_empty_iterator();
+		} else if ( n == 1 ) {
+			return children[ 0 ];
+		} else {
+			return new merging_iterator( comparator, children, n );
+		}
+	}
+
+}// namespace simple_leveldb
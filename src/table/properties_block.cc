@@ -0,0 +1,82 @@
+#include "table/properties_block.h"
+#include "leveldb/comparator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "leveldb/table_properties.h"
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include "util/coding.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	namespace {
+
+		struct property {
+			const char*                  name;
+			uint64_t table_properties::* field;
+		};
+
+		// Sorted by name, the order block_builder requires.
+		const property kProperties[] = {
+			{ "simple_leveldb.creation.time", &table_properties::creation_time },
+			{ "simple_leveldb.data.size", &table_properties::data_size },
+			{ "simple_leveldb.filter.size", &table_properties::filter_size },
+			{ "simple_leveldb.index.size", &table_properties::index_size },
+			{ "simple_leveldb.largest.seqno", &table_properties::largest_seqno },
+			{ "simple_leveldb.num.deletions", &table_properties::num_deletions },
+			{ "simple_leveldb.num.entries", &table_properties::num_entries },
+			{ "simple_leveldb.raw.key.size", &table_properties::raw_key_size },
+			{ "simple_leveldb.raw.value.size", &table_properties::raw_value_size },
+			{ "simple_leveldb.smallest.seqno", &table_properties::smallest_seqno },
+		};
+
+	}// namespace
+
+	status write_properties_block( writable_file* file, const table_properties& props,
+																 uint64_t* offset, block_handle* handle ) {
+		options block_options;
+		block_options.comparator = bytewise_comparator();
+		block_builder builder( &block_options );
+		core::string  value;
+		for ( const auto& p: kProperties ) {
+			value.clear();
+			put_varint64( &value, props.*p.field );
+			builder.add( p.name, value );
+		}
+		return write_raw_block( file, builder.finish(), compression_type::kNoCompression, offset,
+														handle );
+	}
+
+	status read_properties_block( random_access_file* file, const read_options& options,
+																const block_handle& handle, table_properties* props ) {
+		block_contents contents;
+		status         s = read_block( file, options, handle, &contents );
+		if ( !s.is_ok() ) {
+			return s;
+		}
+
+		block     props_block( contents );
+		iterator* iter = props_block.new_iterator( bytewise_comparator() );
+		for ( const auto& p: kProperties ) {
+			iter->seek( p.name );
+			if ( !iter->valid() || iter->key() != slice( p.name ) ) {
+				continue;
+			}
+			slice v = iter->value();
+			if ( !get_varint64( &v, &( props->*p.field ) ) ) {
+				s = status::corruption( "bad table property", p.name );
+				break;
+			}
+		}
+		if ( s.is_ok() ) {
+			s = iter->get_status();
+		}
+		delete iter;
+		return s;
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,182 @@
+#include "leveldb/table.h"
+#include "leveldb/cache.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/iterator.h"
+#include "leveldb/options.h"
+#include "table/block.h"
+#include "table/format.h"
+#include "table/index_reader.h"
+#include "table/properties_block.h"
+#include "table/two_level_iterator.h"
+#include "util/cache_reservation.h"
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	struct table::rep {
+		~rep() {
+			delete index;
+			delete reservation;
+		}
+
+		options             options;
+		status              s;
+		random_access_file* file;
+		uint64_t            cache_id;
+		index_reader*       index;
+		table_properties    props;
+		cache_reservation*  reservation = nullptr;// Charges index to block_cache
+	};
+
+	// Look up "key" in the metaindex block and decode the handle stored
+	// under it.  Returns false if the key is absent or malformed.
+	static bool find_meta_handle( iterator* meta, const slice& key, block_handle* handle ) {
+		meta->seek( key );
+		if ( !meta->valid() || meta->key() != key ) {
+			return false;
+		}
+		slice v = meta->value();
+		return handle->decode_from( &v ).is_ok();
+	}
+
+	status table::open( const options& options, random_access_file* file, uint64_t size,
+											table** table ) {
+		*table = nullptr;
+		if ( size < footer::kEncodedLength ) {
+			return status::corruption( "file is too short to be an sstable" );
+		}
+		if ( options.populate_mmapped_tables && file->reads_in_place() ) {
+			// Only a hint; failing it costs page faults later, nothing more.
+			file->will_need( 0, size );
+		}
+
+		char   footer_space[ footer::kEncodedLength ];
+		slice  footer_input;
+		status s = file->read( size - footer::kEncodedLength, footer::kEncodedLength,
+													 &footer_input, footer_space );
+		if ( !s.is_ok() ) return s;
+
+		footer f;
+		s = f.decode_from( &footer_input );
+		if ( !s.is_ok() ) return s;
+
+		read_options opt;
+		if ( options.paranoid_checks ) {
+			opt.verify_checksums = true;
+		}
+		block_contents meta_contents;
+		s = read_block( file, opt, f.metaindex_handle(), &meta_contents );
+		if ( !s.is_ok() ) return s;
+
+		// The metaindex block tells us how the index was laid out and where the
+		// filter for our policy, if any, lives.
+		index_type       type = index_type::kBinarySearch;
+		block_handle     filter_handle;
+		table_properties props;
+		filter_handle.set_offset( 0 );
+		filter_handle.set_size( 0 );
+		{
+			block     meta( meta_contents );
+			iterator* iter = meta.new_iterator( bytewise_comparator() );
+			iter->seek( kIndexTypeKey );
+			if ( iter->valid() && iter->key() == slice( kIndexTypeKey ) && iter->value().size() == 1 ) {
+				type = static_cast< index_type >( iter->value()[ 0 ] );
+			}
+			if ( options.filter_policy != nullptr ) {
+				core::string key = kFullFilterPrefix;
+				if ( type == index_type::kTwoLevelIndexSearch ) {
+					key = kPartitionedFilterPrefix;
+				}
+				key.append( options.filter_policy->name() );
+				if ( !find_meta_handle( iter, key, &filter_handle ) ) {
+					filter_handle.set_offset( 0 );
+					filter_handle.set_size( 0 );
+				}
+			}
+			block_handle properties_handle;
+			if ( find_meta_handle( iter, kPropertiesBlockKey, &properties_handle ) ) {
+				// The properties are informational; a table whose block cannot be
+				// read is still usable.
+				if ( !read_properties_block( file, opt, properties_handle, &props ).is_ok() ) {
+					props = table_properties();
+				}
+			}
+			delete iter;
+		}
+
+		// Blocks of a file that reads in place are parsed where they lie, so a
+		// cache_id of 0 keeps them, and any filter partitions, out of block_cache.
+		rep* r      = new rep;
+		r->options  = options;
+		r->file     = file;
+		r->props    = props;
+		r->cache_id = ( options.block_cache != nullptr && !file->reads_in_place() )
+									? options.block_cache->new_id()
+									: 0;
+		s           = index_reader::open( r->options, file, r->cache_id, type, f.index_handle(),
+																			filter_handle, &r->index );
+		if ( !s.is_ok() ) {
+			delete r;
+			return s;
+		}
+		if ( options.charge_memory_to_block_cache && options.block_cache != nullptr ) {
+			// The pinned memory is fixed once open, so reserve it exactly.
+			r->reservation = new cache_reservation( options.block_cache, 1 );
+			r->reservation->update( r->index->pinned_memory_usage() );
+		}
+		*table = new class table( r );
+		return s;
+	}
+
+	table::~table() { delete rep_; }
+
+	iterator* table::new_iterator( const read_options& options ) const {
+		rep* const r              = rep_;
+		auto       block_function = [ r, options ]( const slice& index_value ) {
+			block_handle handle;
+			slice        input = index_value;
+			status       s     = handle.decode_from( &input );
+			if ( !s.is_ok() ) {
+				return new_error_iterator( s );
+			}
+			return new_block_iterator( r->options, options, r->file, r->cache_id, handle );
+		};
+		return new_two_level_iterator( r->index->new_index_iterator( options ), block_function );
+	}
+
+	status table::internal_get( const read_options& options, const slice& k,
+															const core::function< void( const slice&, const slice& ) >& handle_result ) {
+		if ( !rep_->index->key_may_match( options, k ) ) {
+			// Not found
+			return status::ok();
+		}
+
+		block_handle handle;
+		status       s = rep_->index->find_data_block( options, k, &handle );
+		if ( s.is_not_found() ) {
+			return status::ok();
+		}
+		if ( !s.is_ok() ) {
+			return s;
+		}
+
+		iterator* block_iter = new_block_iterator_for_get( rep_->options, options, rep_->file,
+																											 rep_->cache_id, handle, k );
+		if ( block_iter->valid() ) {
+			handle_result( block_iter->key(), block_iter->value() );
+		}
+		s = block_iter->get_status();
+		delete block_iter;
+		return s;
+	}
+
+	size_t table::pinned_memory_usage() const {
+		return rep_->index->pinned_memory_usage();
+	}
+
+	const table_properties& table::properties() const { return rep_->props; }
+
+}// namespace simple_leveldb
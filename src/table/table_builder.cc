@@ -0,0 +1,221 @@
+#include "leveldb/table_builder.h"
+#include "leveldb/__detail/db_format.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+#include "leveldb/options.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+#include "table/index_builder.h"
+#include "table/properties_block.h"
+#include "util/coding.h"
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+namespace simple_leveldb {
+
+	struct table_builder::rep {
+		rep( const options& opt, writable_file* f )
+				: options( opt )
+				, file( f )
+				, offset( 0 )
+				, data_block( &options, options.data_block_hash_index )
+				, index_block( &options )
+				, num_entries( 0 )
+				, closed( false )
+				, pending_index_entry( false ) {}
+
+		options          options;
+		writable_file*   file;
+		uint64_t         offset;
+		status           s;
+		block_builder    data_block;
+		index_builder    index_block;
+		core::string     last_key;
+		int64_t          num_entries;
+		bool             closed;// Either finish() or abandon() has been called.
+		table_properties props;
+
+		// We do not emit the index entry for a block until we have seen the
+		// first key for the next data block.  This allows us to use shorter
+		// keys in the index block.  For example, consider a block boundary
+		// between the keys "the quick brown fox" and "the who".  We can use
+		// "the r" as the key for the index block entry since it is >= all
+		// entries in the first block and < all entries in subsequent
+		// blocks.
+		//
+		// Invariant: r->pending_index_entry is true only if data_block is empty.
+		bool         pending_index_entry;
+		block_handle pending_handle;// Handle to add to index block
+	};
+
+	table_builder::table_builder( const options& options, writable_file* file )
+			: rep_( new rep( options, file ) ) {}
+
+	table_builder::~table_builder() {
+		assert( rep_->closed );// Catch errors where caller forgot to call finish()
+		delete rep_;
+	}
+
+	// Account for an entry.  Keys are internal keys; anything shorter than
+	// a tag only counts towards the sizes.
+	static void collect_properties( table_properties* props, const slice& key, const slice& value ) {
+		props->raw_key_size += key.size();
+		props->raw_value_size += value.size();
+		if ( key.size() < 8 ) {
+			return;
+		}
+		const uint64_t        tag  = decode_fixed64( key.data() + key.size() - 8 );
+		const sequence_number seq  = tag >> 8;
+		const value_type      type = static_cast< value_type >( tag & 0xff );
+		if ( type == value_type::kTypeDeletion ) {
+			props->num_deletions++;
+		}
+		if ( props->num_entries == 0 || seq < props->smallest_seqno ) {
+			props->smallest_seqno = seq;
+		}
+		if ( props->num_entries == 0 || seq > props->largest_seqno ) {
+			props->largest_seqno = seq;
+		}
+		props->num_entries++;
+	}
+
+	void table_builder::add( const slice& key, const slice& value ) {
+		rep* r = rep_;
+		assert( !r->closed );
+		if ( !ok() ) return;
+		if ( r->num_entries > 0 ) {
+			assert( r->options.comparator->compare( key, slice( r->last_key ) ) > 0 );
+		}
+
+		if ( r->pending_index_entry ) {
+			assert( r->data_block.empty() );
+			r->index_block.add_index_entry( &r->last_key, &key, r->pending_handle );
+			r->pending_index_entry = false;
+		}
+
+		r->index_block.add_key( key );
+		collect_properties( &r->props, key, value );
+
+		r->last_key.assign( key.data(), key.size() );
+		r->num_entries++;
+		r->data_block.add( key, value );
+
+		const size_t estimated_block_size = r->data_block.current_size_estimate();
+		if ( estimated_block_size >= r->options.block_size ) {
+			flush();
+		}
+	}
+
+	void table_builder::flush() {
+		rep* r = rep_;
+		assert( !r->closed );
+		if ( !ok() ) return;
+		if ( r->data_block.empty() ) return;
+		assert( !r->pending_index_entry );
+		write_block( &r->data_block, &r->pending_handle );
+		if ( ok() ) {
+			r->props.data_size += r->pending_handle.size() + kBlockTrailerSize;
+			r->pending_index_entry = true;
+			r->s                   = r->file->flush();
+		}
+	}
+
+	void table_builder::write_block( block_builder* block, block_handle* handle ) {
+		// File format contains a sequence of blocks where each block has:
+		//    block_data: uint8[n]
+		//    type: uint8
+		//    crc: uint32
+		assert( ok() );
+		rep* r = rep_;
+		r->s   = write_raw_block( r->file, block->finish(), compression_type::kNoCompression,
+															&r->offset, handle );
+		block->reset();
+	}
+
+	status table_builder::get_status() const { return rep_->s; }
+
+	status table_builder::finish() {
+		rep* r = rep_;
+		flush();
+		assert( !r->closed );
+		r->closed = true;
+
+		if ( ok() && r->pending_index_entry ) {
+			r->index_block.add_index_entry( &r->last_key, nullptr, r->pending_handle );
+			r->pending_index_entry = false;
+		}
+
+		// Write filter and index blocks
+		block_handle filter_handle, index_handle, properties_handle, metaindex_handle;
+		if ( ok() ) {
+			r->s = r->index_block.finish( r->file, &r->offset, &index_handle, &filter_handle );
+		}
+
+		// Write properties block
+		if ( ok() ) {
+			r->props.num_entries = r->num_entries;
+			r->props.index_size  = r->index_block.index_size();
+			r->props.filter_size = r->index_block.filter_size();
+			if ( r->options.env != nullptr ) {
+				r->props.creation_time = r->options.env->now_micros() / 1000000;
+			}
+			r->s                 = write_properties_block( r->file, r->props, &r->offset, &properties_handle );
+		}
+
+		// Write metaindex block.  Its keys are compared bytewise, not with the
+		// table's comparator.
+		if ( ok() ) {
+			options meta_options    = r->options;
+			meta_options.comparator = bytewise_comparator();
+			block_builder meta_index_block( &meta_options );
+			if ( r->options.filter_policy != nullptr ) {
+				// Add mapping from "<prefix><filter_name>" to location of filter
+				const bool   partitioned = ( r->index_block.type() == index_type::kTwoLevelIndexSearch );
+				core::string key         = partitioned ? kPartitionedFilterPrefix : kFullFilterPrefix;
+				key.append( r->options.filter_policy->name() );
+				core::string handle_encoding;
+				filter_handle.encode_to( &handle_encoding );
+				meta_index_block.add( key, handle_encoding );
+			}
+
+			const char type = static_cast< char >( r->index_block.type() );
+			meta_index_block.add( kIndexTypeKey, slice( &type, 1 ) );
+
+			core::string handle_encoding;
+			properties_handle.encode_to( &handle_encoding );
+			meta_index_block.add( kPropertiesBlockKey, handle_encoding );
+
+			write_block( &meta_index_block, &metaindex_handle );
+		}
+
+		if ( ok() ) {
+			footer f;
+			f.set_metaindex_handle( metaindex_handle );
+			f.set_index_handle( index_handle );
+			core::string footer_encoding;
+			f.encode_to( &footer_encoding );
+			r->s = r->file->append( footer_encoding );
+			if ( r->s.is_ok() ) {
+				r->offset += footer_encoding.size();
+			}
+		}
+		return r->s;
+	}
+
+	void table_builder::abandon() {
+		rep* r = rep_;
+		assert( !r->closed );
+		r->closed = true;
+	}
+
+	uint64_t table_builder::num_entries() const { return rep_->num_entries; }
+
+	uint64_t table_builder::file_size() const { return rep_->offset; }
+
+	const table_properties& table_builder::properties() const { return rep_->props; }
+
+}// namespace simple_leveldb
@@ -0,0 +1,153 @@
+#include "table/two_level_iterator.h"
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+#include <cassert>
+#include <functional>
+#include <string>
+#include <utility>
+
+namespace simple_leveldb {
+
+	namespace {
+
+		using block_function = core::function< iterator*( const slice& index_value ) >;
+
+		class two_level_iterator : public iterator {
+		private:
+			block_function block_function_;
+			iterator*      index_iter_;
+			iterator*      data_iter_;// May be nullptr
+			status         status_;   // First error of a data iterator we dropped
+			// If data_iter_ is non-null, then "data_block_handle_" holds the
+			// "index_value" passed to block_function_ to create the data_iter_.
+			core::string data_block_handle_;
+
+		public:
+			two_level_iterator( iterator* index_iter, block_function&& block_function )
+					: block_function_( core::move( block_function ) )
+					, index_iter_( index_iter )
+					, data_iter_( nullptr ) {}
+
+			~two_level_iterator() override {
+				delete data_iter_;
+				delete index_iter_;
+			}
+
+		public:
+			bool valid() const override { return data_iter_ != nullptr && data_iter_->valid(); }
+
+			void seek( const slice& target ) override {
+				index_iter_->seek( target );
+				init_data_block();
+				if ( data_iter_ != nullptr ) data_iter_->seek( target );
+				skip_empty_data_blocks_forward();
+			}
+
+			void seek_to_first() override {
+				index_iter_->seek_to_first();
+				init_data_block();
+				if ( data_iter_ != nullptr ) data_iter_->seek_to_first();
+				skip_empty_data_blocks_forward();
+			}
+
+			void seek_to_last() override {
+				index_iter_->seek_to_last();
+				init_data_block();
+				if ( data_iter_ != nullptr ) data_iter_->seek_to_last();
+				skip_empty_data_blocks_backward();
+			}
+
+			void next() override {
+				assert( valid() );
+				data_iter_->next();
+				skip_empty_data_blocks_forward();
+			}
+
+			void prev() override {
+				assert( valid() );
+				data_iter_->prev();
+				skip_empty_data_blocks_backward();
+			}
+
+			slice key() const override {
+				assert( valid() );
+				return data_iter_->key();
+			}
+
+			slice value() const override {
+				assert( valid() );
+				return data_iter_->value();
+			}
+
+			status get_status() const override {
+				if ( !index_iter_->get_status().is_ok() ) {
+					return index_iter_->get_status();
+				} else if ( data_iter_ != nullptr && !data_iter_->get_status().is_ok() ) {
+					return data_iter_->get_status();
+				} else {
+					return status_;
+				}
+			}
+
+		private:
+			void save_error( const status& s ) {
+				if ( status_.is_ok() && !s.is_ok() ) status_ = s;
+			}
+
+			void skip_empty_data_blocks_forward() {
+				while ( data_iter_ == nullptr || !data_iter_->valid() ) {
+					// Move to next block
+					if ( !index_iter_->valid() ) {
+						set_data_iterator( nullptr );
+						return;
+					}
+					index_iter_->next();
+					init_data_block();
+					if ( data_iter_ != nullptr ) data_iter_->seek_to_first();
+				}
+			}
+
+			void skip_empty_data_blocks_backward() {
+				while ( data_iter_ == nullptr || !data_iter_->valid() ) {
+					// Move to previous block
+					if ( !index_iter_->valid() ) {
+						set_data_iterator( nullptr );
+						return;
+					}
+					index_iter_->prev();
+					init_data_block();
+					if ( data_iter_ != nullptr ) data_iter_->seek_to_last();
+				}
+			}
+
+			void set_data_iterator( iterator* data_iter ) {
+				if ( data_iter_ != nullptr ) save_error( data_iter_->get_status() );
+				delete data_iter_;
+				data_iter_ = data_iter;
+			}
+
+			void init_data_block() {
+				if ( !index_iter_->valid() ) {
+					set_data_iterator( nullptr );
+				} else {
+					slice handle = index_iter_->value();
+					if ( data_iter_ != nullptr && handle == slice( data_block_handle_ ) ) {
+						// data_iter_ is already constructed with this iterator, so
+						// no need to change anything
+					} else {
+						iterator* iter = block_function_( handle );
+						data_block_handle_.assign( handle.data(), handle.size() );
+						set_data_iterator( iter );
+					}
+				}
+			}
+		};
+
+	}// namespace
+
+	iterator* new_two_level_iterator( iterator* index_iter, block_function block_function ) {
+		return new two_level_iterator( index_iter, core::move( block_function ) );
+	}
+
+}// namespace simple_leveldb
@@ -0,0 +1,59 @@
+#include "util/cache_reservation.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+
+namespace simple_leveldb {
+
+	cache_reservation::cache_reservation( cache* cache, size_t step )
+			: cache_( cache )
+			, step_( step == 0 ? 1 : step )
+			, id_( cache != nullptr ? cache->new_id() : 0 )
+			, next_sequence_( 0 )
+			, reserved_( 0 ) {}
+
+	cache_reservation::~cache_reservation() {
+		while ( !entries_.empty() ) {
+			release_last();
+		}
+	}
+
+	void cache_reservation::update( size_t bytes ) {
+		if ( cache_ == nullptr ) {
+			return;
+		}
+		const size_t target = ( bytes + step_ - 1 ) / step_ * step_;
+		while ( reserved_ > target ) {
+			release_last();
+		}
+		if ( reserved_ < target ) {
+			char           key[ 16 ];
+			const uint64_t sequence = next_sequence_++;
+			const size_t   charge   = target - reserved_;
+			make_key( sequence, key );
+			cache::handle* h = cache_->insert_reservation( slice( key, sizeof( key ) ), charge );
+			if ( h == nullptr ) {
+				// Nothing was charged; the next update() tries again.
+				return;
+			}
+			entries_.push_back( entry{ h, charge, sequence } );
+			reserved_ = target;
+		}
+	}
+
+	void cache_reservation::make_key( uint64_t sequence, char* key ) const {
+		encode_fixed64( key, id_ );
+		encode_fixed64( key + 8, sequence );
+	}
+
+	// Drop the newest entry from the cache.
+	void cache_reservation::release_last() {
+		const entry& e = entries_.back();
+		char         key[ 16 ];
+		make_key( e.sequence, key );
+		cache_->release( e.handle );
+		cache_->erase( slice( key, sizeof( key ) ) );
+		reserved_ -= e.charge;
+		entries_.pop_back();
+	}
+
+}// namespace simple_leveldb
@@ -140,6 +140,15 @@ namespace simple_leveldb {
 		return reinterpret_cast< char* >( ptr );
 	}
 
+	int32_t varint_length( uint64_t v ) {
+		int32_t len = 1;
+		while ( v >= 128 ) {
+			v >>= 7;
+			len++;
+		}
+		return len;
+	}
+
 	void put_length_prefixed_slice( core::string* dst, const slice& value ) {
 		put_varint32( dst, value.size() );
 		dst->append( value.data(), value.size() );
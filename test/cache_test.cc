@@ -0,0 +1,181 @@
+#include "leveldb/cache.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "leveldb/slice.h"
+
+// Multithreaded smoke test of the cache implementations: threads insert,
+// look up, erase and release over a small key space with some handles
+// pinned, then the test checks that usage, pinned_usage and the deleter
+// calls balance.
+
+#define CHECK( cond )                                                        \
+	do {                                                                       \
+		if ( !( cond ) ) {                                                       \
+			std::fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+										#cond );                                                   \
+			std::abort();                                                          \
+		}                                                                        \
+	} while ( false )
+
+namespace simple_leveldb {
+
+	namespace {
+
+		static const int kNumThreads   = 4;
+		static const int kOpsPerThread = 100000;
+		static const int kNumKeys      = 500;
+		static const int kMaxPinned    = 8;
+		static const int kMaxCharge    = 4;
+
+		struct entry {
+			int    id;
+			size_t charge;
+		};
+
+		core::atomic< int64_t > g_inserted{ 0 };
+		core::atomic< int64_t > g_inserted_charge{ 0 };
+		core::atomic< int64_t > g_deleted{ 0 };
+		core::atomic< int64_t > g_deleted_charge{ 0 };
+
+		static core::string key_of( int id ) { return "k" + core::to_string( id ); }
+
+		static void delete_entry( const slice& key, void* value ) {
+			entry* e = reinterpret_cast< entry* >( value );
+			CHECK( key == slice( key_of( e->id ) ) );
+			g_deleted++;
+			g_deleted_charge += e->charge;
+			delete e;
+		}
+
+		static void check_entry( cache* c, cache::handle* h, int id ) {
+			const entry* e = reinterpret_cast< const entry* >( c->value( h ) );
+			CHECK( e->id == id );
+		}
+
+		static void run_ops( cache* c, uint32_t seed ) {
+			core::mt19937                                     rnd( seed );
+			core::vector< core::pair< cache::handle*, int > > pinned;
+			for ( int i = 0; i < kOpsPerThread; i++ ) {
+				const int          id  = static_cast< int >( rnd() % kNumKeys );
+				const core::string key = key_of( id );
+				cache::handle*     h   = nullptr;
+				switch ( rnd() % 4 ) {
+					case 0:
+					case 1: {
+						entry*     e   = new entry{ id, 1 + rnd() % kMaxCharge };
+						const auto pri = rnd() % 2 ? cache::priority::kHigh : cache::priority::kLow;
+						g_inserted++;
+						g_inserted_charge += e->charge;
+						h = c->insert( key, e, e->charge, &delete_entry, pri );
+						CHECK( h != nullptr );
+						break;
+					}
+					case 2:
+						h = c->look_up( key );
+						break;
+					default:
+						c->erase( key );
+						break;
+				}
+				if ( h == nullptr ) {
+					continue;
+				}
+				check_entry( c, h, id );
+				pinned.emplace_back( h, id );
+				if ( pinned.size() > kMaxPinned ) {
+					const size_t victim = rnd() % pinned.size();
+					check_entry( c, pinned[ victim ].first, pinned[ victim ].second );
+					c->release( pinned[ victim ].first );
+					pinned.erase( pinned.begin() + victim );
+				}
+			}
+			for ( const auto& p: pinned ) {
+				check_entry( c, p.first, p.second );
+				c->release( p.first );
+			}
+		}
+
+		// While handles are held, all of the cache's usage is pinned.
+		static void check_pinned( cache* c ) {
+			core::vector< cache::handle* > handles;
+			size_t                         charge = 0;
+			for ( int id = 0; id < 16; id++ ) {
+				entry* e = new entry{ id, 1 };
+				g_inserted++;
+				g_inserted_charge += e->charge;
+				charge            += e->charge;
+				handles.push_back( c->insert( key_of( id ), e, e->charge, &delete_entry ) );
+			}
+			cache::stats stats;
+			c->get_stats( &stats );
+			CHECK( stats.usage == charge );
+			CHECK( stats.pinned_usage == charge );
+			for ( cache::handle* h: handles ) {
+				c->release( h );
+			}
+			c->get_stats( &stats );
+			CHECK( stats.usage == charge );
+			CHECK( stats.pinned_usage == 0 );
+			for ( int id = 0; id < 16; id++ ) {
+				c->erase( key_of( id ) );
+			}
+		}
+
+		static void test_cache( const char* name, cache* c, size_t capacity ) {
+			g_inserted = g_inserted_charge = g_deleted = g_deleted_charge = 0;
+
+			check_pinned( c );
+			CHECK( g_deleted == g_inserted );
+
+			core::vector< core::thread > threads;
+			for ( int t = 0; t < kNumThreads; t++ ) {
+				threads.emplace_back( run_ops, c, 301 + t );
+			}
+			for ( core::thread& t: threads ) {
+				t.join();
+			}
+
+			// Every entry that is not yet deleted is in the cache, unpinned.
+			cache::stats stats;
+			c->get_stats( &stats );
+			CHECK( stats.pinned_usage == 0 );
+			CHECK( stats.usage == c->total_charge() );
+			CHECK( static_cast< int64_t >( stats.usage ) == g_inserted_charge - g_deleted_charge );
+			CHECK( stats.usage <= capacity );
+
+			for ( int id = 0; id < kNumKeys; id++ ) {
+				c->erase( key_of( id ) );
+			}
+			c->get_stats( &stats );
+			CHECK( stats.usage == 0 );
+			CHECK( g_deleted == g_inserted );
+			CHECK( g_deleted_charge == g_inserted_charge );
+
+			delete c;
+			CHECK( g_deleted == g_inserted );
+			std::fprintf( stderr, "%s: ok (%lld entries)\n", name, static_cast< long long >( g_inserted.load() ) );
+		}
+
+	}// end anonymous namespace
+
+}// namespace simple_leveldb
+
+int main( int, char** ) {
+	using namespace simple_leveldb;
+	// Capacities are multiples of the shard count, so per-shard capacities
+	// add up to exactly the total.
+	static const size_t kCapacity = 16 * 32;
+	test_cache( "lru", new_lru_cache( kCapacity ), kCapacity );
+	test_cache( "lru_priority_pool", new_lru_cache( kCapacity, 0.5 ), kCapacity );
+	test_cache( "tiny_lfu", new_tiny_lfu_cache( kCapacity, 0.5 ), kCapacity );
+	test_cache( "clock", new_clock_cache( kCapacity, 2 ), kCapacity );
+	return 0;
+}